@@ -0,0 +1,202 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+// Round trip of one render block through the worker pool: dispatch, every
+// worker runs its share, join. "legacy" is the mutex and two condition
+// variables the thread manager used before WorkBarrier, reproduced as it
+// was. Each round gives every worker work_us of busy work, 0 measures the
+// bare dispatch and join. With more workers than hardware threads, their
+// work runs one after the other and adds up in the round time.
+//
+// WorkBarrier only spins with more than one hardware thread, on a single
+// one both sides go straight to sleep.
+
+#include "Bench.hpp"
+#include "../src/WorkBarrier.hpp"
+#include <condition_variable>
+#include <mutex>
+
+using namespace OmniMIDI;
+using namespace OmniMIDI::Bench;
+
+#define BARRIER_BENCH_ROUNDS 2000
+
+static void BusyWork(uint32_t us) {
+    if (!us)
+        return;
+
+    const Clock::time_point end = Clock::now() + std::chrono::microseconds(us);
+    while (Clock::now() < end)
+        CPU_PAUSE();
+}
+
+class LegacyPool {
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable work_done;
+    uint8_t *thread_is_working;
+    uint32_t active_thread_count = 0;
+    bool work_in_progress = false;
+    bool should_exit = false;
+
+    uint32_t num_threads;
+    uint32_t work_us;
+    std::vector<std::thread> threads;
+
+    void ThreadFunc(uint32_t idx) {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lck(mutex);
+                work_available.wait(lck, [&] {
+                    return (work_in_progress && thread_is_working[idx]) ||
+                           should_exit;
+                });
+
+                if (should_exit)
+                    break;
+            }
+
+            BusyWork(work_us);
+
+            {
+                std::unique_lock<std::mutex> lck(mutex);
+                thread_is_working[idx] = 0;
+                if (--active_thread_count == 0) {
+                    work_in_progress = false;
+                    work_done.notify_one();
+                }
+            }
+        }
+    }
+
+  public:
+    LegacyPool(uint32_t count, uint32_t us) : num_threads(count), work_us(us) {
+        thread_is_working = new uint8_t[count]{};
+        for (uint32_t i = 0; i < count; i++)
+            threads.emplace_back(&LegacyPool::ThreadFunc, this, i);
+    }
+
+    ~LegacyPool() {
+        {
+            std::unique_lock<std::mutex> lck(mutex);
+            should_exit = true;
+            work_available.notify_all();
+        }
+
+        for (auto &t : threads)
+            t.join();
+        delete[] thread_is_working;
+    }
+
+    void Round() {
+        std::unique_lock<std::mutex> lck(mutex);
+
+        active_thread_count = num_threads;
+        work_in_progress = true;
+        for (uint32_t i = 0; i < num_threads; i++)
+            thread_is_working[i] = 1;
+
+        work_available.notify_all();
+        work_done.wait(lck, [&] { return !work_in_progress; });
+    }
+};
+
+class BarrierPool {
+    struct alignas(WORKBARRIER_CACHELINE) Worker {
+        WorkBarrier::Spinner spinner;
+    };
+
+    WorkBarrier barrier;
+    WorkBarrier::Spinner spinner;
+    Worker *workers;
+
+    uint32_t work_us;
+    std::vector<std::thread> threads;
+
+    void ThreadFunc(uint32_t idx) {
+        uint32_t seen = 0;
+
+        while (barrier.WaitWork(seen, workers[idx].spinner)) {
+            BusyWork(work_us);
+            barrier.Arrive();
+        }
+    }
+
+  public:
+    BarrierPool(uint32_t count, uint32_t us) : work_us(us) {
+        workers = new Worker[count];
+        barrier.SetWorkers(count);
+        for (uint32_t i = 0; i < count; i++)
+            threads.emplace_back(&BarrierPool::ThreadFunc, this, i);
+    }
+
+    ~BarrierPool() {
+        barrier.Shutdown();
+        for (auto &t : threads)
+            t.join();
+        delete[] workers;
+    }
+
+    void Round() {
+        barrier.Dispatch();
+        barrier.Wait(spinner);
+    }
+};
+
+template <class P> static void Run(const char *name, uint32_t count,
+                                   uint32_t work_us) {
+    P pool(count, work_us);
+    std::vector<double> times;
+
+    // Let the workers start and the spin budgets settle
+    for (int i = 0; i < 100; i++)
+        pool.Round();
+
+    for (int i = 0; i < BARRIER_BENCH_ROUNDS; i++) {
+        const Clock::time_point start = Clock::now();
+        pool.Round();
+        times.push_back(Seconds(start) * 1e6);
+    }
+
+    const double median = Percentile(times, 50.0);
+    printf("  %-11s %2u workers, %3u us work: median %7.1f us, "
+           "p99 %7.1f us\n",
+           name, count, work_us, median, Percentile(times, 99.0));
+}
+
+int main() {
+    printf("Worker pool round trip, %u hardware threads, %d rounds\n",
+           std::thread::hardware_concurrency(), BARRIER_BENCH_ROUNDS);
+
+    // A worker per hardware thread, as the renderer does by default, then
+    // the pools that oversubscribe it
+    std::vector<uint32_t> counts = {
+        std::max(std::thread::hardware_concurrency(), 1u), 4, 16, 64};
+    std::sort(counts.begin(), counts.end());
+    counts.erase(std::unique(counts.begin(), counts.end()), counts.end());
+
+    for (uint32_t work_us : {0u, 100u}) {
+        for (uint32_t count : counts) {
+            Run<LegacyPool>("legacy", count, work_us);
+            Run<BarrierPool>("WorkBarrier", count, work_us);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+// Shared bits of the microbenchmarks, see the bench_* targets in xmake.lua.
+// They're opt-in and never built by default, run them with e.g.
+// "xmake build bench_nps && xmake run bench_nps".
+
+#ifndef _OM_BENCH_H
+#define _OM_BENCH_H
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#define BENCH_RUNS 5
+
+namespace OmniMIDI::Bench {
+using Clock = std::chrono::steady_clock;
+
+inline double Seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Runs f() runs times and returns the fastest run, in seconds
+template <class F> double BestOf(int runs, F &&f) {
+    double best = 1e300;
+
+    for (int i = 0; i < runs; i++) {
+        const Clock::time_point start = Clock::now();
+        f();
+        best = std::min(best, Seconds(start));
+    }
+
+    return best;
+}
+
+// Sorts v in place and returns its p-th percentile
+inline double Percentile(std::vector<double> &v, double p) {
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t)(v.size() * p / 100.0))];
+}
+
+inline void PrintHeader(const char *name) {
+    printf("%s, %u hardware threads, best of %d runs\n", name,
+           std::thread::hardware_concurrency(), BENCH_RUNS);
+}
+} // namespace OmniMIDI::Bench
+
+#endif
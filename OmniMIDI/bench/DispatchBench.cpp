@@ -0,0 +1,98 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+// Short event dispatch, from SynthModule::PlayShortEvent() into the ring,
+// for a 10M event burst on one thread. "legacy" goes through the virtual
+// PlayShortEvent() -> UPlayShortEvent() -> BEvBuf::Write() chain of the
+// plain SynthModule, "typed" through BufferedSynthModule<T>, which binds
+// the ring type at compile time. Both are called through a SynthModule
+// pointer, like SynthHost does, into a ring large enough for the whole
+// burst.
+
+#include "Bench.hpp"
+#include "../src/synth/SynthModule.hpp"
+
+using namespace OmniMIDI;
+using namespace OmniMIDI::Bench;
+
+#define DISPATCH_BENCH_EVENTS 10000000
+#define DISPATCH_BENCH_RING (1 << 24)
+
+template <class T> class LegacyModule : public SynthModule {
+  public:
+    LegacyModule() {
+        delete ShortEvents;
+        ShortEvents = new T(DISPATCH_BENCH_RING);
+    }
+    ~LegacyModule() { FreeShortEvBuf(); }
+
+    void Rewind() { ShortEvents->ResetHeads(); }
+};
+
+template <class T> class TypedModule final : public BufferedSynthModule<T> {
+  public:
+    TypedModule() { this->AllocateShortEvBuf(DISPATCH_BENCH_RING); }
+    ~TypedModule() { this->FreeShortEvBuf(); }
+
+    void Rewind() { this->Events->ResetHeads(); }
+};
+
+// Keeps the compiler from seeing the module's actual type
+static SynthModule *volatile target = nullptr;
+
+static void Burst() {
+    SynthModule *synth = target;
+
+    for (uint32_t i = 0; i < DISPATCH_BENCH_EVENTS; i++)
+        synth->PlayShortEvent(0x7F3C90 | (i & 0xF));
+}
+
+template <class M> static double Run(const char *name) {
+    M module;
+    target = &module;
+
+    // The first burst faults the ring in
+    Burst();
+
+    const double best = BestOf(BENCH_RUNS, [&] {
+        module.Rewind();
+        Burst();
+    });
+
+    const double rate = DISPATCH_BENCH_EVENTS / best / 1e6;
+    printf("  %-22s %6.2f ns/event, %7.1f M events/s\n", name,
+           best * 1e9 / DISPATCH_BENCH_EVENTS, rate);
+
+    target = nullptr;
+    return rate;
+}
+
+int main() {
+    PrintHeader("SynthModule::PlayShortEvent(), 10M event burst");
+
+    const double legacy = Run<LegacyModule<EvBuf>>("legacy, EvBuf");
+    const double typed = Run<TypedModule<EvBuf>>("typed, EvBuf");
+    Run<LegacyModule<MPSCEvBuf>>("legacy, MPSCEvBuf");
+    Run<TypedModule<MPSCEvBuf>>("typed, MPSCEvBuf");
+    Run<LegacyModule<LanedEvBuf>>("legacy, LanedEvBuf");
+    Run<TypedModule<LanedEvBuf>>("typed, LanedEvBuf");
+
+    printf("  typed/legacy on EvBuf: %.2fx\n", typed / legacy);
+    return 0;
+}
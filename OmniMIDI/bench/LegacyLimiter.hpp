@@ -0,0 +1,163 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+// The per-sample compressor AudioLimiter replaced, kept as the baseline of
+// LimiterBench.cpp. It's the old code as it was, but for two changes: the
+// delay line is zeroed (it used to come straight from malloc), and
+// process() takes the interleaved buffer AudioLimiter works on instead of
+// a std::vector.
+
+#ifndef _OM_LEGACY_LIMITER_H
+#define _OM_LEGACY_LIMITER_H
+
+#pragma once
+
+#include <math.h>
+#include <stdexcept>
+#include <stdlib.h>
+#include <vector>
+
+namespace OmniMIDI::Bench {
+
+class LegacyCompressor {
+  public:
+    LegacyCompressor(float sample_rate, float threshold, float ratio,
+                     float attack_ms, float release_ms, float lookahead_ms) {
+        if (sample_rate <= 0) {
+            throw std::runtime_error("Invalid sample rate");
+        }
+
+        this->threshold = threshold;
+        this->ratio = ratio;
+
+        this->attack_coeff = calculate_coeff(attack_ms, sample_rate);
+        this->release_coeff = calculate_coeff(release_ms, sample_rate);
+        this->envelope = 0.0f;
+        this->gain = 1.0f;
+
+        this->buffer_size = (size_t)(lookahead_ms * 0.001f * sample_rate);
+        if (this->buffer_size < 1) {
+            this->buffer_size = 1;
+        }
+
+        this->delay_buffer = (float *)calloc(this->buffer_size, sizeof(float));
+        if (!this->delay_buffer) {
+            throw std::runtime_error(
+                "Failed to allocate memory for delay buffer");
+        }
+
+        this->write_index = 0;
+        this->read_index = 1;
+    }
+
+    ~LegacyCompressor() { free(this->delay_buffer); }
+
+    float process(float input) {
+        float output;
+
+        // --- Lookahead Delay Line ---
+        delay_buffer[write_index] = input;
+        float delayed_input = delay_buffer[read_index];
+        float lookahead_sample = input;
+
+        // --- Envelope Detection ---
+        float rectified_sample = fabsf(lookahead_sample);
+        if (rectified_sample > envelope) {
+            envelope = attack_coeff * envelope +
+                       (1.0f - attack_coeff) * rectified_sample;
+        } else {
+            envelope = release_coeff * envelope +
+                       (1.0f - release_coeff) * rectified_sample;
+        }
+
+        // --- Gain Computation ---
+        float target_gain = 1.0f;
+        if (envelope > threshold) {
+            target_gain =
+                (threshold + (envelope - threshold) / ratio) / envelope;
+        }
+
+        // --- Gain Application ---
+        if (target_gain < gain) {
+            gain = target_gain; // Instant attack
+        } else {
+            // Smooth release
+            gain = release_coeff * gain + (1.0f - release_coeff) * target_gain;
+        }
+
+        // --- Apply Gain ---
+        output = delayed_input * gain;
+
+        // --- Update Buffer Indices ---
+        write_index = (write_index + 1) % buffer_size;
+        read_index = (read_index + 1) % buffer_size;
+
+        return output;
+    }
+
+  private:
+    float threshold;
+    float ratio;
+
+    float attack_coeff;
+    float release_coeff;
+    float envelope;
+    float gain;
+
+    float *delay_buffer;
+    size_t buffer_size;
+    size_t write_index;
+    size_t read_index;
+
+    static float calculate_coeff(float time_ms, float sample_rate) {
+        if (time_ms <= 0.0f)
+            return 1.0f;
+        return expf(-1.0f / (time_ms * 0.001f * sample_rate));
+    }
+};
+
+class LegacyLimiter {
+  private:
+    std::vector<LegacyCompressor *> compressors;
+    uint16_t num_channels;
+
+  public:
+    LegacyLimiter(uint16_t channels, uint32_t sample_rate) {
+        num_channels = channels;
+        for (uint16_t i = 0; i < channels; i++) {
+            compressors.push_back(new LegacyCompressor(
+                sample_rate, 0.3, 1000.0, 10.0, 50.0, 10.0));
+        }
+    }
+
+    ~LegacyLimiter() {
+        for (auto c : compressors) {
+            delete c;
+        }
+    }
+
+    void process(float *samples, size_t frames) {
+        for (size_t i = 0; i < frames * num_channels; i++) {
+            samples[i] = compressors[i % num_channels]->process(samples[i]);
+        }
+    }
+};
+} // namespace OmniMIDI::Bench
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+// AudioLimiter against the compressor it replaced (LegacyLimiter.hpp), at
+// 48 kHz stereo, fed a minute of audio in 480 frame (10 ms) callbacks like
+// the device thread would. Two signals, both alternating 100 ms bursts
+// above the threshold with quieter passages: a tone with some noise, and
+// two plain tones. Besides the time, it prints the loudest sample that
+// came out, which should stay at LIMITER_THRESHOLD.
+
+#include "Bench.hpp"
+#include "LegacyLimiter.hpp"
+#include "../src/audio/Limiter.hpp"
+#include <cmath>
+#include <random>
+
+using namespace OmniMIDI;
+using namespace OmniMIDI::Bench;
+
+#define LIMITER_BENCH_RATE 48000
+#define LIMITER_BENCH_CALLBACK 480
+#define LIMITER_BENCH_FRAMES (LIMITER_BENCH_RATE * 60)
+
+static std::vector<float> MakeSignal(bool noisy) {
+    std::vector<float> out(LIMITER_BENCH_FRAMES * 2);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+
+    for (size_t i = 0; i < LIMITER_BENCH_FRAMES; i++) {
+        const float env = (i / 4800) % 3 == 0 ? 1.2f : 0.2f;
+        float l, r;
+
+        if (noisy) {
+            l = env * sinf(i * 0.05f) + 0.05f * noise(rng);
+            r = 0.8f * l + 0.05f * noise(rng);
+        } else {
+            l = env * 0.5f * (sinf(i * 0.05f) + sinf(i * 0.0173f));
+            r = 0.8f * l;
+        }
+
+        out[i * 2] = l;
+        out[i * 2 + 1] = r;
+    }
+
+    return out;
+}
+
+template <class L>
+static void Run(const char *name, const std::vector<float> &signal) {
+    std::vector<float> buf;
+    float peak = 0.0f;
+
+    const double best = BestOf(BENCH_RUNS, [&] {
+        buf = signal;
+        L limiter(2, LIMITER_BENCH_RATE);
+
+        for (size_t f = 0; f < LIMITER_BENCH_FRAMES;
+             f += LIMITER_BENCH_CALLBACK)
+            limiter.process(&buf[f * 2], LIMITER_BENCH_CALLBACK);
+    });
+
+    for (float s : buf)
+        peak = std::max(peak, fabsf(s));
+
+    printf("  %-8s %5.1f ns/frame, %5.0fx realtime, peak out %.3f\n", name,
+           best * 1e9 / LIMITER_BENCH_FRAMES, 60.0 / best, peak);
+}
+
+int main() {
+    PrintHeader("AudioLimiter, 48 kHz stereo, 480 frame callbacks");
+    printf("  kernel: %s, threshold %.3f\n", AudioLimiter::KernelName(),
+           LIMITER_THRESHOLD);
+
+    for (bool noisy : {true, false}) {
+        const std::vector<float> signal = MakeSignal(noisy);
+
+        printf(" %s bursts\n", noisy ? "noisy" : "tonal");
+        Run<LegacyLimiter>("legacy", signal);
+        Run<AudioLimiter>("current", signal);
+    }
+
+    return 0;
+}
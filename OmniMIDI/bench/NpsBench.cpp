@@ -0,0 +1,96 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+// note_on() throughput of NpsLimiter. The cap is set high enough that
+// most notes go through, so the ring and the running sum do their full
+// work, with the time read from the monotonic clock on every call as in
+// the renderer.
+
+#include "Bench.hpp"
+#include "../src/audio/NpsLimiter.hpp"
+#include <atomic>
+
+using namespace OmniMIDI;
+using namespace OmniMIDI::Bench;
+
+#define NPS_BENCH_CHANNELS 64
+#define NPS_BENCH_NOTES 20000000
+#define NPS_BENCH_MAX 1000000
+
+static std::atomic<uint64_t> sink = 0;
+
+// Every thread plays count notes spread over all the channels, offset so
+// that they don't all start on the same one
+static void PlayNotes(NpsLimiter &limiter, uint32_t offset, uint32_t count,
+                      bool with_off) {
+    uint64_t passed = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        const uint32_t ch = (i + offset) % NPS_BENCH_CHANNELS;
+        const uint8_t key = (i / NPS_BENCH_CHANNELS) & 0x7F;
+
+        passed += limiter.note_on(ch, key, (i % 127) + 1);
+        if (with_off)
+            limiter.note_off(ch, key);
+    }
+
+    sink.fetch_add(passed, std::memory_order_relaxed);
+}
+
+static void Run(const char *name, uint32_t threads, bool with_off) {
+    const uint32_t per_thread = NPS_BENCH_NOTES / threads;
+    uint64_t passed = 0;
+
+    const double best = BestOf(BENCH_RUNS, [&] {
+        NpsLimiter limiter(NPS_BENCH_CHANNELS, NPS_BENCH_MAX);
+        std::vector<std::thread> pool;
+
+        sink = 0;
+        for (uint32_t t = 1; t < threads; t++)
+            pool.emplace_back(PlayNotes, std::ref(limiter), t * 7, per_thread,
+                              with_off);
+        PlayNotes(limiter, 0, per_thread, with_off);
+
+        for (auto &t : pool)
+            t.join();
+        passed = sink;
+    });
+
+    const double total = (double)per_thread * threads;
+    printf("  %-22s %2u thread(s): %6.1f ns/note, %6.1f M notes/s, "
+           "%4.1f%% passed\n",
+           name, threads, best * 1e9 / total, total / best / 1e6,
+           100.0 * passed / total);
+}
+
+int main() {
+    PrintHeader("NpsLimiter::note_on()");
+
+    const uint32_t hw = std::max(std::thread::hardware_concurrency(), 1u);
+
+    Run("note_on", 1, false);
+    Run("note_on + note_off", 1, true);
+
+    if (hw > 1) {
+        Run("note_on", hw, false);
+        Run("note_on + note_off", hw, true);
+    }
+
+    return 0;
+}
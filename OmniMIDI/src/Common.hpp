@@ -63,6 +63,17 @@
     #define _M_ARM64                __aarch64__
 #endif
 
+// Busy-wait hint, for spin loops
+#if defined(_M_IX86) || defined(_M_AMD64) || defined(_M_X64)
+    #include <immintrin.h>
+    #define CPU_PAUSE()             _mm_pause()
+#elif defined(_M_ARM) || defined(_M_ARM64)
+    #define CPU_PAUSE()             __asm__ __volatile__("yield")
+#else
+    #include <thread>
+    #define CPU_PAUSE()             std::this_thread::yield()
+#endif
+
 #if defined(_WIN32)
     //  Microsoft 
     #define EXPORT			        __declspec(dllexport)
@@ -84,4 +95,18 @@ typedef struct {
     uint16_t channels;
 } AudioStreamParams;
 
+// Snapshot of the output counters, see BufferedRenderer.
+// Plain data, so that it can be handed to KDMAPI clients as is.
+typedef struct AudioMetrics {
+    // Device callbacks served
+    uint64_t Reads;
+    // Callbacks that found fewer samples ready than they asked for, and
+    // the samples that were played as silence because of it
+    uint64_t Underruns;
+    uint64_t LateSamples;
+    // Samples ready after the last callback, and frames per rendered block
+    uint64_t Buffered;
+    uint64_t RenderSize;
+} AudioMetrics;
+
 #endif
\ No newline at end of file
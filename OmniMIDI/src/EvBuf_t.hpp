@@ -25,11 +25,15 @@
 #define BEvBuf BaseEvBuf_t
 #define EvBuf EvBuf_t
 #define LEvBuf LEvBuf_t
+#define MPSCEvBuf MPSCEvBuf_t
+#define LanedEvBuf LanedEvBuf_t
 #define ShortEvent uint32_t
 
+// Keep the producer and consumer heads on separate cache lines
+#define EVBUF_CACHELINE 64
+
 #define DEF_EVBUF_SIZE 4096
-#define MAX_EVBUF_SIZE UINT_MAX / 8
-#define MAX_LEVBUF_SIZE 64
+#define MAX_EVBUF_SIZE (UINT_MAX / 8)
 
 #if !defined(_WIN64) && !defined(__x86_64__)
 #define MAX_MIDIHDR_BUF 65536
@@ -37,15 +41,42 @@
 #define MAX_MIDIHDR_BUF 131072
 #endif
 
+// Long events ring size in bytes, enough for a few full size SysEx dumps
+#define DEF_LEVBUF_SIZE (MAX_MIDIHDR_BUF * 4)
+
+// Producer threads that get a lane of their own in LanedEvBuf_t,
+// and how many events its consumer merges in one go
+#define EVBUF_MAX_LANES 8
+#define EVBUF_MERGE_CHUNK 1024
+
+// How many LanedEvBuf_t a producer thread can hold a lane in at once
+#define EVBUF_LANE_CACHE 4
+
+// Latency histogram buckets (powers of two, in ns), and event types
+// the drops are sorted by (note off, note on, ... system)
+#define EVBUF_LATENCY_BUCKETS 32
+#define EVBUF_EVENT_TYPES 8
+
+#include "Common.hpp"
+#include <atomic>
+#include <bit>
+#include <thread>
+#include <chrono>
+#include <climits>
 #include <cstdint>
 #include <cstddef>
 #include <cstring>
+#include <memory>
+#include <span>
 
-#ifdef _STATSDEV
-#include <future>
-#include <iostream>
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
 
+// How long a producer waits for room in a full ring before giving up (ns)
+#define EVBUF_BLOCK_TIMEOUT 5000000
+
 namespace OmniMIDI {
 typedef struct AdvShortEvent {
     uint8_t status = 0;
@@ -53,15 +84,165 @@ typedef struct AdvShortEvent {
     uint8_t param2 = 0;
 } AdvShortEv, *PAdvShortEv, ASE, *PASE;
 
-typedef struct LongEvent {
-    uint8_t ev[MAX_MIDIHDR_BUF] = {0};
-    size_t len = 0;
-} LongEv, *PLongEv, LE, *PLE;
+
+// Monotonic clock used to timestamp short events, in nanoseconds
+inline uint64_t EvBufTime() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// What a short events ring does when it runs out of room
+enum EvBufOverflow {
+    // Drop the incoming event
+    OverflowDrop = 0,
+    // Wait for the consumer to make room, up to EVBUF_BLOCK_TIMEOUT
+    OverflowBlock = 1,
+    // Past the high water mark, the consumer skips the oldest note-ons
+    // still queued, and producers wait for room like OverflowBlock
+    OverflowDropOldest = 2,
+    // Past the high water mark, incoming note-ons are refused, so that the
+    // rest of the ring stays free for note-offs, CCs and resets
+    OverflowDropNoteOns = 3,
+    OVERFLOW_COUNT = OverflowDropNoteOns
+};
+
+// Snapshot of the counters of a ring, see EvBufStats.
+// Plain data, so that it can be handed to KDMAPI clients as is.
+typedef struct EvBufMetrics {
+    uint64_t Capacity;
+    uint64_t EventsIn;
+    uint64_t EventsOut;
+    uint64_t Dropped[EVBUF_EVENT_TYPES];
+    uint64_t NoteOnsDropped;
+    uint64_t Blocked;
+    uint64_t Evicted;
+    uint64_t Coalesced;
+    uint64_t HighWater;
+    uint64_t Latency[EVBUF_LATENCY_BUCKETS];
+} EvBufMetrics;
+
+// Counters kept by the short event rings, always on.
+// Events in and out come from the heads themselves, everything else is
+// here, on cache lines of its own so that it never bounces the heads.
+struct EvBufStats {
+    // Producers, only touched when an event can't be queued right away
+    // Events lost for good, because the policy says so or the wait timed out
+    alignas(EVBUF_CACHELINE) std::atomic<uint64_t> Dropped[EVBUF_EVENT_TYPES] =
+        {};
+    // Writes that had to wait for room
+    std::atomic<uint64_t> Blocked = 0;
+    // Note-ons refused by OverflowDropNoteOns, also counted in Dropped
+    std::atomic<uint64_t> NoteOnsDropped = 0;
+
+    // Consumer
+    // Stale note-ons skipped with OverflowDropOldest
+    alignas(EVBUF_CACHELINE) std::atomic<uint64_t> Evicted = 0;
+    // Most events the consumer ever found waiting
+    std::atomic<uint64_t> HighWater = 0;
+    // Time between the write and the consumer being done with the event,
+    // bucket i counts the events that took [2^i, 2^(i+1)) ns
+    std::atomic<uint64_t> Latency[EVBUF_LATENCY_BUCKETS] = {};
+
+    void Drop(uint32_t ev) {
+        Dropped[(ev >> 4) & 7].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Consumer only, no need for a RMW
+    void Backlog(uint64_t count) {
+        if (count > HighWater.load(std::memory_order_relaxed))
+            HighWater.store(count, std::memory_order_relaxed);
+    }
+
+    void Dispatched(const uint64_t *stamps, size_t count, uint64_t now) {
+        uint32_t hist[EVBUF_LATENCY_BUCKETS] = {0};
+
+        for (size_t i = 0; i < count; i++) {
+            const uint64_t diff = now > stamps[i] ? now - stamps[i] : 0;
+            const uint32_t bucket = diff ? std::bit_width(diff) - 1 : 0;
+
+            hist[bucket < EVBUF_LATENCY_BUCKETS ? bucket
+                                                : EVBUF_LATENCY_BUCKETS - 1]++;
+        }
+
+        for (size_t i = 0; i < EVBUF_LATENCY_BUCKETS; i++) {
+            if (hist[i])
+                Latency[i].store(
+                    Latency[i].load(std::memory_order_relaxed) + hist[i],
+                    std::memory_order_relaxed);
+        }
+    }
+
+    // Adds the counters to m, the high water mark is the highest of the two
+    void AddTo(EvBufMetrics &m) const {
+        for (size_t i = 0; i < EVBUF_EVENT_TYPES; i++)
+            m.Dropped[i] += Dropped[i].load(std::memory_order_relaxed);
+
+        m.NoteOnsDropped += NoteOnsDropped.load(std::memory_order_relaxed);
+        m.Blocked += Blocked.load(std::memory_order_relaxed);
+        m.Evicted += Evicted.load(std::memory_order_relaxed);
+
+        const uint64_t hwm = HighWater.load(std::memory_order_relaxed);
+        if (hwm > m.HighWater)
+            m.HighWater = hwm;
+
+        for (size_t i = 0; i < EVBUF_LATENCY_BUCKETS; i++)
+            m.Latency[i] += Latency[i].load(std::memory_order_relaxed);
+    }
+};
+
+// Note-ons are the only events that are safe to lose, a note-on with
+// no velocity is a note-off
+constexpr bool IsDroppableEvent(uint32_t ev) {
+    return (ev & 0xF0) == 0x90 && (ev & 0x7F0000);
+}
+
+// Waits a little before retrying a write into a full ring. Spins first,
+// then yields, and returns false once EVBUF_BLOCK_TIMEOUT has passed.
+inline bool EvBufBackoff(uint32_t &attempt, uint64_t &deadline) {
+    if (attempt++ < 64) {
+        CPU_PAUSE();
+        return true;
+    }
+
+    const uint64_t now = EvBufTime();
+
+    if (!deadline)
+        deadline = now + EVBUF_BLOCK_TIMEOUT;
+    else if (now >= deadline)
+        return false;
+
+    std::this_thread::yield();
+    return true;
+}
+
+// OverflowDropOldest, consumer side: once the backlog goes past highWater,
+// the oldest note-ons are zeroed out (the synths skip empty events) until
+// what's left would fit under lowWater. Everything else is kept.
+inline void ShedStaleEvents(std::span<ShortEvent> evs, size_t backlog,
+                            size_t highWater, size_t lowWater,
+                            EvBufStats &stats) {
+    if (backlog <= highWater)
+        return;
+
+    size_t excess = backlog - lowWater;
+    size_t evicted = 0;
+
+    if (excess > evs.size())
+        excess = evs.size();
+
+    for (size_t i = 0; i < excess; i++) {
+        if (IsDroppableEvent(evs[i])) {
+            evs[i] = 0;
+            evicted++;
+        }
+    }
+
+    stats.Evicted.fetch_add(evicted, std::memory_order_relaxed);
+}
 
 class BaseEvBuf_t {
   protected:
-    size_t readHead = 0;
-    size_t writeHead = 0;
     size_t size = 0;
 
   private:
@@ -75,17 +256,58 @@ class BaseEvBuf_t {
     virtual bool Allocate(size_t ReqSize) { return true; }
     virtual bool Free() { return true; }
 
-    // Short messages
-    virtual void Write(uint32_t ev) {}
+    // Short messages, Write() returns false if the event got dropped
+    virtual bool Write(uint32_t ev) { return false; }
     virtual void Write(uint8_t status, uint8_t param1, uint8_t param2) {}
 
+    // Write() that never waits for room, for producers holding a lock.
+    // retry is set if the ring was full and its policy would have waited,
+    // the event isn't counted as dropped in that case.
+    virtual bool TryWrite(uint32_t ev, bool &retry) {
+        retry = false;
+        return Write(ev);
+    }
+
     virtual ShortEvent Read() { return 0; }
     virtual ShortEvent Peek() { return 0; }
     virtual ShortEvent *ReadPtr() { return nullptr; }
     virtual ShortEvent *PeekPtr() { return nullptr; }
 
+    // Bulk reads, for the consumers
+    // ReadBatch copies up to max events out of the buffer, AcquireReadable
+    // returns the contiguous run of events available right now, without
+    // consuming them. The run has to be handed back with Release().
+    virtual size_t ReadBatch(ShortEvent *out, size_t max) { return 0; }
+    virtual std::span<ShortEvent> AcquireReadable() { return {}; }
+    virtual void Release(size_t count) {}
+
+    // Capture times of the run returned by AcquireReadable(), in EvBufTime()
+    // units, or nullptr if the buffer doesn't timestamp its events
+    virtual uint64_t *ReadableStamps() { return nullptr; }
+
     // Long messages
-    virtual void Write(uint8_t *ev, size_t len) {}
+    // ReadLong/PeekLong copy the message into ev, which has to be able to
+    // hold MAX_MIDIHDR_BUF bytes. AcquireLong returns the next message
+    // in place, and ReleaseLong drops it once the caller is done with it.
+    // Write() returns false if the message didn't fit.
+    virtual bool Write(uint8_t *ev, size_t len) { return false; }
+    virtual std::span<uint8_t> AcquireLong() { return {}; }
+    virtual void ReleaseLong() {}
+
+    // Long messages that have to be played in order with the short ones.
+    // WriteLinked stores the message, and writes status | ticket << 8 to
+    // the short events ring as a placeholder for it, the message is only
+    // kept if the placeholder made it. AcquireLinked finds the message back
+    // from its placeholder, whatever order the placeholders come in, and
+    // ReleaseLinked drops it. Not to be mixed with AcquireLong/ReleaseLong.
+    virtual bool WriteLinked(uint8_t *ev, size_t len, BaseEvBuf_t *events,
+                             uint8_t status) {
+        return false;
+    }
+    virtual std::span<uint8_t> AcquireLinked(uint32_t placeholder) {
+        return {};
+    }
+    virtual void ReleaseLinked(uint32_t placeholder) {}
     virtual void ReadLong(uint8_t *ev, size_t *len) {
         *ev = longDummy;
         *len = sizeof(longDummy);
@@ -95,99 +317,165 @@ class BaseEvBuf_t {
         *len = sizeof(longDummy);
     }
 
-    virtual bool NewEventsAvailable() { return false; }
-    virtual void ResetHeads() {
-        readHead = 0;
-        writeHead = 0;
+    // Short messages overflow handling
+    virtual void SetOverflowPolicy(EvBufOverflow policy) {}
+
+    // Counters, AddMetrics() adds this buffer's to m
+    virtual void AddMetrics(EvBufMetrics &m) {}
+    void GetMetrics(EvBufMetrics &m) {
+        m = {};
+        AddMetrics(m);
     }
+
+    virtual bool NewEventsAvailable() { return false; }
+    virtual void ResetHeads() {}
     virtual size_t GetReadHeadPos() { return 0; }
     virtual size_t GetWriteHeadPos() { return 0; }
 };
 
-class LEvBuf_t : public BaseEvBuf_t {
+// Backing memory for the short event rings, and their timestamps.
+// Capacity is always a power of two, so that heads can be masked instead of
+// wrapped with a modulo. On Linux, the same memfd gets mapped twice back to
+// back, which means buf[i] and buf[i + size] are the same event, and any
+// readable run is one contiguous range even when it crosses the end of the
+// ring. Everywhere else (or if the mapping fails), it's a plain allocation
+// and consumers have to split their reads at the wrap point.
+template <class T> class EvBufMemory {
   private:
-    PLE buf = nullptr;
-
-  public:
-    LEvBuf_t() {}
-
-    LEvBuf_t(size_t ReqSize) { Allocate(ReqSize); }
+    T *ptr = nullptr;
+    size_t bytes = 0;
+    bool mirrored = false;
+
+#if defined(__linux__)
+    bool MapMirrored() {
+        int fd = memfd_create("OmniMIDI_EvBuf", MFD_CLOEXEC);
+        if (fd == -1)
+            return false;
 
-    ~LEvBuf_t() { Free(); }
+        if (ftruncate(fd, bytes) == -1) {
+            close(fd);
+            return false;
+        }
 
-    bool Allocate(size_t ReqSize) override {
-        if (buf)
+        // Reserve the whole range first, then map the file twice over it
+        auto base = (uint8_t *)mmap(nullptr, bytes * 2, PROT_NONE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            close(fd);
             return false;
+        }
 
-        size = ReqSize;
+        if (mmap(base, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+                 fd, 0) == MAP_FAILED ||
+            mmap(base + bytes, bytes, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+            munmap(base, bytes * 2);
+            close(fd);
+            return false;
+        }
 
-        if (size < 2)
-            size = 2;
-        else if (size > MAX_LEVBUF_SIZE)
-            size = MAX_LEVBUF_SIZE;
+        // The mappings keep the file alive
+        close(fd);
 
-        buf = new LE[size];
+        ptr = (T *)base;
+        mirrored = true;
         return true;
     }
+#endif
 
-    bool Free() override {
-        if (!buf)
-            return false;
+  public:
+    EvBufMemory() {}
+    ~EvBufMemory() { Free(); }
+
+    // Rounds ReqSize up to a power of two (and to the page size, if the
+    // buffer can be mirrored), then allocates it. Returns the final capacity
+    // in elements, or 0 on failure.
+    size_t Allocate(size_t ReqSize) {
+        if (ptr)
+            return 0;
 
-        size = 0;
-        readHead = 0;
-        writeHead = 0;
+        if (ReqSize < 8)
+            ReqSize = 8;
 
-        delete[] buf;
-        buf = nullptr;
+#if !defined(_WIN64) && !defined(__x86_64__)
+        else if (ReqSize > MAX_EVBUF_SIZE)
+            ReqSize = MAX_EVBUF_SIZE;
+#endif
 
-        return true;
-    }
+        size_t count = 8;
+        while (count < ReqSize)
+            count <<= 1;
 
-    void Write(uint8_t *ev, size_t len) override {
-        auto tWriteHead = (writeHead + 1) % size;
+#if defined(__linux__)
+        const size_t pageElements = sysconf(_SC_PAGESIZE) / sizeof(T);
+        if (count < pageElements)
+            count = pageElements;
 
-        if (tWriteHead != readHead)
-            writeHead = tWriteHead;
+        bytes = count * sizeof(T);
+        if (MapMirrored())
+            return count;
+#endif
 
-        memcpy(buf[writeHead].ev, ev, len);
-        buf[writeHead].len = len;
-    }
+        bytes = count * sizeof(T);
+        ptr = new T[count]{};
+        mirrored = false;
 
-    void ReadLong(uint8_t *ev, size_t *len) override {
-        if (readHead != writeHead) {
-            if (++readHead >= size)
-                readHead = 0;
-            ev = buf[readHead].ev;
-            *len = buf[readHead].len;
-        }
+        return ptr ? count : 0;
     }
 
-    void PeekLong(uint8_t *ev, size_t *len) override {
-        auto tNextHead = (readHead + 1) % size;
+    void Free() {
+        if (!ptr)
+            return;
 
-        ev = buf[tNextHead].ev;
-        *len = buf[tNextHead].len;
-    }
+#if defined(__linux__)
+        if (mirrored)
+            munmap(ptr, bytes * 2);
+        else
+#endif
+            delete[] ptr;
 
-    bool NewEventsAvailable() override { return (readHead != writeHead); }
+        ptr = nullptr;
+        bytes = 0;
+        mirrored = false;
+    }
 
-    size_t GetReadHeadPos() override { return readHead; }
-    size_t GetWriteHeadPos() override { return writeHead; }
+    T *Get() { return ptr; }
+    bool IsMirrored() { return mirrored; }
 };
 
-class EvBuf_t : public BaseEvBuf_t {
+// Single producer, single consumer ring.
+// writeHead and readHead are free running counters, masked into the buffer
+// on access: the ring is empty when they match, and full when the producer
+// is a whole buffer ahead of the consumer.
+// Each side keeps a private snapshot of the opposite head, and only goes
+// back to the shared atomic when the snapshot says the ring is full/empty.
+class EvBuf_t final : public BaseEvBuf_t {
   private:
+    EvBufMemory<ShortEvent> mem;
+    EvBufMemory<uint64_t> stampMem;
+    ShortEvent *buf = nullptr;
+    uint64_t *stamps = nullptr;
+    size_t mask = 0;
+    bool mirrored = false;
+
+    // Can be changed while the producers are writing
+    std::atomic<EvBufOverflow> policy = OverflowDrop;
+    size_t highWater = 0;
+
+    // Producer
+    alignas(EVBUF_CACHELINE) std::atomic<size_t> writeHead = 0;
+    size_t cachedReadHead = 0;
     uint8_t runningStatus = 0;
 
-#ifdef _STATSDEV
-    FILE *dummy;
-    size_t evSent = 0;
-    size_t evSkipped = 0;
-#endif
+    // Consumer
+    alignas(EVBUF_CACHELINE) std::atomic<size_t> readHead = 0;
+    size_t cachedWriteHead = 0;
 
-    ShortEvent *buf = nullptr;
-    bool dontMiss = false;
+    alignas(EVBUF_CACHELINE) EvBufStats stats;
+
+    // Pad the tail, so that whatever gets allocated next to us
+    // doesn't end up sharing the last cache line
+    alignas(EVBUF_CACHELINE) char tailPad = 0;
 
     constexpr uint32_t ApplyRunningStatus(uint32_t ev) {
         if (ev & 0x80) {
@@ -198,6 +486,79 @@ class EvBuf_t : public BaseEvBuf_t {
         return (ev << 8) | runningStatus;
     }
 
+    // How many events can be read in one go, starting from curReadHead
+    inline size_t Readable(size_t curReadHead) {
+        cachedWriteHead = writeHead.load(std::memory_order_acquire);
+
+        size_t avail = cachedWriteHead - curReadHead;
+        size_t tail = size - (curReadHead & mask);
+
+        return (!mirrored && avail > tail) ? tail : avail;
+    }
+
+    // Slow path of Write(), the ring looked full for this event
+    bool WaitForRoom(size_t curWriteHead, size_t room, uint32_t ev) {
+        // Note-on past the high water mark
+        if (room != size) {
+            stats.NoteOnsDropped.fetch_add(1, std::memory_order_relaxed);
+            stats.Drop(ev);
+            return false;
+        }
+
+        if (Policy() != OverflowDrop) {
+            uint32_t attempt = 0;
+            uint64_t deadline = 0;
+
+            stats.Blocked.fetch_add(1, std::memory_order_relaxed);
+            while (EvBufBackoff(attempt, deadline)) {
+                cachedReadHead = readHead.load(std::memory_order_acquire);
+
+                if (curWriteHead - cachedReadHead < size)
+                    return true;
+            }
+        }
+
+        stats.Drop(ev);
+        return false;
+    }
+
+    inline EvBufOverflow Policy() const {
+        return policy.load(std::memory_order_relaxed);
+    }
+
+    // Write(), or TryWrite() if retry isn't null
+    bool Put(uint32_t ev, uint64_t stamp, bool *retry) {
+        const size_t curWriteHead = writeHead.load(std::memory_order_relaxed);
+
+        ev = ApplyRunningStatus(ev);
+
+        // Note-ons don't get the part of the ring past the high water mark
+        const size_t room =
+            (Policy() == OverflowDropNoteOns && IsDroppableEvent(ev))
+                ? highWater
+                : size;
+
+        if (curWriteHead - cachedReadHead >= room) {
+            cachedReadHead = readHead.load(std::memory_order_acquire);
+
+            if (curWriteHead - cachedReadHead >= room) {
+                if (retry && room == size && Policy() != OverflowDrop) {
+                    *retry = true;
+                    return false;
+                }
+
+                if (!WaitForRoom(curWriteHead, room, ev))
+                    return false;
+            }
+        }
+
+        buf[curWriteHead & mask] = ev;
+        if (stamps)
+            stamps[curWriteHead & mask] = stamp;
+        writeHead.store(curWriteHead + 1, std::memory_order_release);
+        return true;
+    }
+
   public:
     EvBuf_t() {}
 
@@ -205,27 +566,42 @@ class EvBuf_t : public BaseEvBuf_t {
 
     ~EvBuf_t() { Free(); }
 
-    void SetMissMode(bool val) { dontMiss = val; }
-
     bool Allocate(size_t ReqSize) override {
         if (buf)
             return false;
 
-        size = ReqSize;
+        size = mem.Allocate(ReqSize);
 
-        if (size < 8)
-            size = 8;
+        if (!size)
+            return false;
 
-#if !defined(_WIN64) && !defined(__x86_64__)
-        else if (size > MAX_EVBUF_SIZE)
-            size = MAX_EVBUF_SIZE;
-#endif
+        buf = mem.Get();
+        mask = size - 1;
+        mirrored = mem.IsMirrored();
+        highWater = size - (size / 4);
 
-        buf = new ShortEvent[size]{};
+        cachedReadHead = 0;
+        cachedWriteHead = 0;
+        readHead.store(0, std::memory_order_relaxed);
+        writeHead.store(0, std::memory_order_release);
 
-        if (!buf)
+        return true;
+    }
+
+    // Stamps every event written from now on with EvBufTime(), has to be
+    // called after Allocate() and before any producer starts writing
+    bool EnableTimestamps() {
+        if (!buf || stamps)
+            return stamps != nullptr;
+
+        // Same capacity as the events, and mirrored the same way
+        if (stampMem.Allocate(size) != size ||
+            stampMem.IsMirrored() != mirrored) {
+            stampMem.Free();
             return false;
+        }
 
+        stamps = stampMem.Get();
         return true;
     }
 
@@ -233,18 +609,18 @@ class EvBuf_t : public BaseEvBuf_t {
         if (!buf)
             return false;
 
-#ifdef _STATSDEV
-        GetStats();
-        evSent = 0;
-        evSkipped = 0;
-#endif
-        readHead = 0;
-        writeHead = 0;
+        readHead.store(0, std::memory_order_relaxed);
+        writeHead.store(0, std::memory_order_relaxed);
+        cachedReadHead = 0;
+        cachedWriteHead = 0;
 
-        delete[] buf;
+        mem.Free();
+        stampMem.Free();
         buf = nullptr;
+        stamps = nullptr;
 
         size = 0;
+        mask = 0;
         return true;
     }
 
@@ -252,47 +628,114 @@ class EvBuf_t : public BaseEvBuf_t {
         Write(status | (param1 << 8) | (param2 << 16));
     }
 
-    void Write(uint32_t ev) override {
-        size_t curReadHead = readHead;
-        size_t nextWriteHead = (writeHead + 1) % size;
+    bool Write(uint32_t ev) override {
+        return Write(ev, stamps ? EvBufTime() : 0);
+    }
+
+    // Write() with the capture time supplied by the caller, for rings that
+    // pass on events, and their stamps, taken from another ring.
+    // False if the event was dropped
+    bool Write(uint32_t ev, uint64_t stamp) { return Put(ev, stamp, nullptr); }
 
-        if (nextWriteHead != curReadHead) {
-#ifdef _STATSDEV
-            evSent++;
-#endif
+    bool TryWrite(uint32_t ev, bool &retry) override {
+        retry = false;
+        return Put(ev, stamps ? EvBufTime() : 0, &retry);
+    }
+
+    // The returned slot is handed back to the producer,
+    // so it's only safe to dereference right away
+    ShortEvent *ReadPtr() override {
+        const size_t curReadHead = readHead.load(std::memory_order_relaxed);
 
-            buf[nextWriteHead] = ApplyRunningStatus(ev);
-            writeHead = nextWriteHead;
+        if (curReadHead == cachedWriteHead) {
+            cachedWriteHead = writeHead.load(std::memory_order_acquire);
 
-            return;
+            if (curReadHead == cachedWriteHead)
+                return nullptr;
         }
 
-#ifdef _STATSDEV
-        // Buffer full
-        evSkipped++;
-#endif
+        readHead.store(curReadHead + 1, std::memory_order_release);
+        return &buf[curReadHead & mask];
     }
 
-    ShortEvent *ReadPtr() override {
-        if (readHead == writeHead)
-            return nullptr;
+    ShortEvent Read() override {
+        const size_t curReadHead = readHead.load(std::memory_order_relaxed);
+
+        if (curReadHead == cachedWriteHead) {
+            cachedWriteHead = writeHead.load(std::memory_order_acquire);
 
-        readHead = (readHead + 1) % size;
-        return &buf[readHead];
+            if (curReadHead == cachedWriteHead)
+                return 0;
+        }
+
+        // Copy the event out before releasing the slot to the producer
+        ShortEvent ev = buf[curReadHead & mask];
+        readHead.store(curReadHead + 1, std::memory_order_release);
+
+        return ev;
     }
 
-    ShortEvent Read() override {
-        auto val = ReadPtr();
+    size_t ReadBatch(ShortEvent *out, size_t max) override {
+        const size_t curReadHead = readHead.load(std::memory_order_relaxed);
+        size_t count = 0;
 
-        if (val == nullptr)
-            return 0;
+        // Without the mirror, this goes around twice if the run wraps
+        while (count < max) {
+            size_t avail = Readable(curReadHead + count);
 
-        return *val;
+            if (!avail)
+                break;
+
+            if (avail > max - count)
+                avail = max - count;
+
+            memcpy(out + count, buf + ((curReadHead + count) & mask),
+                   avail * sizeof(ShortEvent));
+            count += avail;
+        }
+
+        if (count)
+            readHead.store(curReadHead + count, std::memory_order_release);
+
+        return count;
+    }
+
+    std::span<ShortEvent> AcquireReadable() override {
+        const size_t curReadHead = readHead.load(std::memory_order_relaxed);
+        std::span<ShortEvent> evs = {buf + (curReadHead & mask),
+                                     Readable(curReadHead)};
+
+        stats.Backlog(cachedWriteHead - curReadHead);
+        if (Policy() == OverflowDropOldest)
+            ShedStaleEvents(evs, cachedWriteHead - curReadHead, highWater,
+                            size / 2, stats);
+
+        return evs;
+    }
+
+    void Release(size_t count) override {
+        readHead.store(readHead.load(std::memory_order_relaxed) + count,
+                       std::memory_order_release);
+    }
+
+    uint64_t *ReadableStamps() override {
+        if (!stamps)
+            return nullptr;
+
+        return stamps + (readHead.load(std::memory_order_relaxed) & mask);
     }
 
     ShortEvent *PeekPtr() override {
-        auto tNextHead = (readHead + 1) % size;
-        return &buf[tNextHead];
+        const size_t curReadHead = readHead.load(std::memory_order_relaxed);
+
+        if (curReadHead == cachedWriteHead) {
+            cachedWriteHead = writeHead.load(std::memory_order_acquire);
+
+            if (curReadHead == cachedWriteHead)
+                return nullptr;
+        }
+
+        return &buf[curReadHead & mask];
     }
 
     ShortEvent Peek() override {
@@ -304,11 +747,1117 @@ class EvBuf_t : public BaseEvBuf_t {
         return *val;
     }
 
-    bool NewEventsAvailable() override { return readHead != writeHead; }
+    void SetOverflowPolicy(EvBufOverflow policy) override {
+        this->policy.store(policy, std::memory_order_relaxed);
+    }
+
+    void AddMetrics(EvBufMetrics &m) override {
+        m.Capacity += size;
+        m.EventsIn += writeHead.load(std::memory_order_relaxed);
+        m.EventsOut += readHead.load(std::memory_order_relaxed);
+        stats.AddTo(m);
+    }
+
+    bool NewEventsAvailable() override {
+        const size_t curReadHead = readHead.load(std::memory_order_relaxed);
+
+        if (curReadHead != cachedWriteHead)
+            return true;
+
+        cachedWriteHead = writeHead.load(std::memory_order_acquire);
+        return curReadHead != cachedWriteHead;
+    }
+
+    // Consumer side, drops whatever hasn't been read yet
+    void ResetHeads() override {
+        cachedWriteHead = writeHead.load(std::memory_order_acquire);
+        readHead.store(cachedWriteHead, std::memory_order_release);
+    }
 
-    size_t GetReadHeadPos() override { return readHead; }
-    size_t GetWriteHeadPos() override { return writeHead; }
+    size_t GetReadHeadPos() override {
+        return readHead.load(std::memory_order_relaxed) & mask;
+    }
+    size_t GetWriteHeadPos() override {
+        return writeHead.load(std::memory_order_relaxed) & mask;
+    }
 };
-} // namespace OmniMIDI
 
-#endif
\ No newline at end of file
+// Multiple producers, single consumer ring.
+// Bounded queue based on per-slot sequence numbers: a producer claims a
+// position with a CAS on writePos, fills the slot, then publishes it by
+// bumping the slot's sequence. The consumer only ever touches readPos.
+// Any number of threads can write at the same time, LanedEvBuf_t uses it
+// for the producers that didn't get a lane of their own.
+class MPSCEvBuf_t final : public BaseEvBuf_t {
+  private:
+    EvBufMemory<ShortEvent> mem;
+    EvBufMemory<uint64_t> stampMem;
+    ShortEvent *buf = nullptr;
+    uint64_t *stamps = nullptr;
+    std::atomic<size_t> *seq = nullptr;
+    size_t mask = 0;
+    bool mirrored = false;
+
+    // Can be changed while the producers are writing
+    std::atomic<EvBufOverflow> policy = OverflowDrop;
+    size_t highWater = 0;
+
+    // Producers
+    alignas(EVBUF_CACHELINE) std::atomic<size_t> writePos = 0;
+    std::atomic<uint8_t> runningStatus = 0;
+
+    // Consumer
+    alignas(EVBUF_CACHELINE) std::atomic<size_t> readPos = 0;
+
+    alignas(EVBUF_CACHELINE) EvBufStats stats;
+
+    alignas(EVBUF_CACHELINE) char tailPad = 0;
+
+    inline uint32_t ApplyRunningStatus(uint32_t ev) {
+        if (ev & 0x80) {
+            runningStatus.store(ev & 0xFF, std::memory_order_relaxed);
+            return ev;
+        }
+
+        return (ev << 8) | runningStatus.load(std::memory_order_relaxed);
+    }
+
+    inline EvBufOverflow Policy() const {
+        return policy.load(std::memory_order_relaxed);
+    }
+
+    // Write(), or TryWrite() if retry isn't null
+    bool Put(uint32_t ev, bool *retry) {
+        size_t pos = writePos.load(std::memory_order_relaxed);
+        uint32_t attempt = 0;
+        uint64_t deadline = 0;
+
+        ev = ApplyRunningStatus(ev);
+
+        // Note-ons don't get the part of the ring past the high water mark
+        if (Policy() == OverflowDropNoteOns && IsDroppableEvent(ev) &&
+            pos - readPos.load(std::memory_order_relaxed) >= highWater) {
+            stats.NoteOnsDropped.fetch_add(1, std::memory_order_relaxed);
+            stats.Drop(ev);
+            return false;
+        }
+
+        for (;;) {
+            const size_t slotSeq =
+                seq[pos & mask].load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)slotSeq - (intptr_t)pos;
+
+            if (diff == 0) {
+                // Slot is free, try to claim it
+                if (writePos.compare_exchange_weak(pos, pos + 1,
+                                                   std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                // Buffer full
+                if (retry && Policy() != OverflowDrop) {
+                    *retry = true;
+                    return false;
+                }
+
+                if (Policy() == OverflowDrop ||
+                    !EvBufBackoff(attempt, deadline)) {
+                    stats.Drop(ev);
+                    return false;
+                }
+
+                if (attempt == 1)
+                    stats.Blocked.fetch_add(1, std::memory_order_relaxed);
+
+                pos = writePos.load(std::memory_order_relaxed);
+            } else
+                pos = writePos.load(std::memory_order_relaxed);
+        }
+
+        buf[pos & mask] = ev;
+        if (stamps)
+            stamps[pos & mask] = EvBufTime();
+        seq[pos & mask].store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+  public:
+    MPSCEvBuf_t() {}
+
+    MPSCEvBuf_t(size_t ReqSize) { Allocate(ReqSize); }
+
+    ~MPSCEvBuf_t() { Free(); }
+
+    bool Allocate(size_t ReqSize) override {
+        if (buf)
+            return false;
+
+        size = mem.Allocate(ReqSize);
+
+        if (!size)
+            return false;
+
+        buf = mem.Get();
+        seq = new std::atomic<size_t>[size];
+
+        if (!seq) {
+            mem.Free();
+            buf = nullptr;
+            size = 0;
+            return false;
+        }
+
+        mask = size - 1;
+        mirrored = mem.IsMirrored();
+        highWater = size - (size / 4);
+        for (size_t i = 0; i < size; i++)
+            seq[i].store(i, std::memory_order_relaxed);
+
+        readPos.store(0, std::memory_order_relaxed);
+        writePos.store(0, std::memory_order_release);
+
+        return true;
+    }
+
+    // Stamps every event written from now on with EvBufTime(), has to be
+    // called after Allocate() and before any producer starts writing
+    bool EnableTimestamps() {
+        if (!buf || stamps)
+            return stamps != nullptr;
+
+        // Same capacity as the events, and mirrored the same way
+        if (stampMem.Allocate(size) != size ||
+            stampMem.IsMirrored() != mirrored) {
+            stampMem.Free();
+            return false;
+        }
+
+        stamps = stampMem.Get();
+        return true;
+    }
+
+    bool Free() override {
+        if (!buf)
+            return false;
+
+        readPos.store(0, std::memory_order_relaxed);
+        writePos.store(0, std::memory_order_relaxed);
+
+        mem.Free();
+        stampMem.Free();
+        delete[] seq;
+        buf = nullptr;
+        stamps = nullptr;
+        seq = nullptr;
+
+        size = 0;
+        mask = 0;
+        return true;
+    }
+
+    void Write(uint8_t status, uint8_t param1, uint8_t param2) override {
+        Write(status | (param1 << 8) | (param2 << 16));
+    }
+
+    bool Write(uint32_t ev) override { return Put(ev, nullptr); }
+
+    bool TryWrite(uint32_t ev, bool &retry) override {
+        retry = false;
+        return Put(ev, &retry);
+    }
+
+    // The returned slot is handed back to the producers,
+    // so it's only safe to dereference right away
+    ShortEvent *ReadPtr() override {
+        const size_t pos = readPos.load(std::memory_order_relaxed);
+        const size_t slot = pos & mask;
+
+        if (seq[slot].load(std::memory_order_acquire) != pos + 1)
+            return nullptr;
+
+        seq[slot].store(pos + size, std::memory_order_release);
+        readPos.store(pos + 1, std::memory_order_relaxed);
+        return &buf[slot];
+    }
+
+    ShortEvent Read() override {
+        const size_t pos = readPos.load(std::memory_order_relaxed);
+        const size_t slot = pos & mask;
+
+        if (seq[slot].load(std::memory_order_acquire) != pos + 1)
+            return 0;
+
+        // Copy the event out before releasing the slot to the producers
+        ShortEvent ev = buf[slot];
+        seq[slot].store(pos + size, std::memory_order_release);
+        readPos.store(pos + 1, std::memory_order_relaxed);
+
+        return ev;
+    }
+
+    size_t ReadBatch(ShortEvent *out, size_t max) override {
+        const size_t pos = readPos.load(std::memory_order_relaxed);
+        size_t count = 0;
+
+        for (; count < max; count++) {
+            const size_t slot = (pos + count) & mask;
+
+            if (seq[slot].load(std::memory_order_acquire) != pos + count + 1)
+                break;
+
+            out[count] = buf[slot];
+        }
+
+        if (count)
+            MPSCEvBuf_t::Release(count);
+
+        return count;
+    }
+
+    // Slots are published out of order by the producers, so the run
+    // ends at the first slot that hasn't been filled yet
+    std::span<ShortEvent> AcquireReadable() override {
+        const size_t pos = readPos.load(std::memory_order_relaxed);
+        const size_t slot = pos & mask;
+        const size_t limit = mirrored ? size : size - slot;
+        size_t count = 0;
+
+        for (; count < limit; count++) {
+            if (seq[(slot + count) & mask].load(std::memory_order_acquire) !=
+                pos + count + 1)
+                break;
+        }
+
+        std::span<ShortEvent> evs = {buf + slot, count};
+        const size_t backlog = writePos.load(std::memory_order_relaxed) - pos;
+
+        stats.Backlog(backlog);
+        if (Policy() == OverflowDropOldest)
+            ShedStaleEvents(evs, backlog, highWater, size / 2, stats);
+
+        return evs;
+    }
+
+    void Release(size_t count) override {
+        const size_t pos = readPos.load(std::memory_order_relaxed);
+
+        for (size_t i = 0; i < count; i++)
+            seq[(pos + i) & mask].store(pos + i + size,
+                                        std::memory_order_release);
+
+        readPos.store(pos + count, std::memory_order_relaxed);
+    }
+
+    uint64_t *ReadableStamps() override {
+        if (!stamps)
+            return nullptr;
+
+        return stamps + (readPos.load(std::memory_order_relaxed) & mask);
+    }
+
+    ShortEvent *PeekPtr() override {
+        const size_t pos = readPos.load(std::memory_order_relaxed);
+        const size_t slot = pos & mask;
+
+        if (seq[slot].load(std::memory_order_acquire) != pos + 1)
+            return nullptr;
+
+        return &buf[slot];
+    }
+
+    ShortEvent Peek() override {
+        auto val = PeekPtr();
+
+        if (val == nullptr)
+            return 0;
+
+        return *val;
+    }
+
+    void SetOverflowPolicy(EvBufOverflow policy) override {
+        this->policy.store(policy, std::memory_order_relaxed);
+    }
+
+    void AddMetrics(EvBufMetrics &m) override {
+        m.Capacity += size;
+        m.EventsIn += writePos.load(std::memory_order_relaxed);
+        m.EventsOut += readPos.load(std::memory_order_relaxed);
+        stats.AddTo(m);
+    }
+
+    bool NewEventsAvailable() override {
+        const size_t pos = readPos.load(std::memory_order_relaxed);
+        return seq[pos & mask].load(std::memory_order_acquire) == pos + 1;
+    }
+
+    // Consumer side, drops whatever has been published so far
+    void ResetHeads() override {
+        while (NewEventsAvailable())
+            Read();
+    }
+
+    size_t GetReadHeadPos() override {
+        return readPos.load(std::memory_order_relaxed) & mask;
+    }
+    size_t GetWriteHeadPos() override {
+        return writePos.load(std::memory_order_relaxed) & mask;
+    }
+};
+
+// Which lanes of a LanedEvBuf_t are taken. Shared with the producers, so
+// that a thread exiting after the ring is gone doesn't touch freed memory.
+struct EvBufLaneClaims {
+    std::atomic<bool> claimed[EVBUF_MAX_LANES] = {};
+};
+
+// The lane a producer thread got from a LanedEvBuf_t, handed back when
+// the thread exits. lane is null if the ring was out of lanes.
+struct EvBufLane {
+    uint64_t ringId = 0;
+    size_t index = 0;
+    EvBuf_t *lane = nullptr;
+    std::weak_ptr<EvBufLaneClaims> claims;
+
+    // Unused, or its ring is gone
+    bool IsStale() const { return !ringId || (lane && claims.expired()); }
+
+    void Drop() {
+        if (auto c = claims.lock())
+            c->claimed[index].store(false, std::memory_order_release);
+
+        claims.reset();
+        lane = nullptr;
+        ringId = 0;
+    }
+
+    ~EvBufLane() { Drop(); }
+};
+
+// The lanes of a producer thread, one per ring, so that a thread writing
+// to a few rings in turn keeps its lane in each of them
+struct EvBufLaneCache {
+    EvBufLane rings[EVBUF_LANE_CACHE];
+    size_t victim = 0;
+
+    // The entry of ringId, or the one its lane should be claimed in
+    EvBufLane &Find(uint64_t ringId) {
+        EvBufLane *spare = nullptr;
+
+        for (EvBufLane &r : rings) {
+            if (r.ringId == ringId)
+                return r;
+
+            if (!spare && r.IsStale())
+                spare = &r;
+        }
+
+        if (spare)
+            return *spare;
+
+        // All taken, they get given up in turn
+        return rings[victim++ % EVBUF_LANE_CACHE];
+    }
+};
+
+// One SPSC lane per producer thread, merged back together by capture time.
+// A producer claims a free lane the first time it writes, and keeps it
+// until it exits, or writes to more than EVBUF_LANE_CACHE rings. Threads
+// that don't get a lane share the fallback MPSC ring. Every event is
+// timestamped, the consumer picks the oldest head across all the lanes
+// until the merge buffer is full, so events coming from different clients
+// get to the synth in the order they were captured.
+// If only one lane has something to read, its run is returned as is.
+class LanedEvBuf_t final : public BaseEvBuf_t {
+  private:
+    static inline std::atomic<uint64_t> nextRingId = 1;
+    static inline thread_local EvBufLaneCache laneCache;
+
+    // Zero while the ring isn't allocated, read by the producers
+    std::atomic<uint64_t> ringId = 0;
+    std::shared_ptr<EvBufLaneClaims> claims;
+    std::atomic<EvBuf_t *> lanes[EVBUF_MAX_LANES] = {};
+    MPSCEvBuf_t fallback;
+    // Can be changed while the producers are writing
+    std::atomic<EvBufOverflow> policy = OverflowDrop;
+    bool timed = false;
+
+    // Consumer
+    ShortEvent *merged = nullptr;
+    uint64_t *mergedStamps = nullptr;
+    size_t mergedPos = 0;
+    size_t mergedLen = 0;
+    BaseEvBuf_t *direct = nullptr;
+
+    // Latency and backlog across all the lanes
+    alignas(EVBUF_CACHELINE) EvBufStats stats;
+
+    // Slow path of Write(), first event from this thread on this ring
+    void ClaimLane(EvBufLane &c, uint64_t id) {
+        c.Drop();
+        c.ringId = id;
+
+        for (size_t i = 0; i < EVBUF_MAX_LANES; i++) {
+            bool expected = false;
+
+            if (!claims->claimed[i].compare_exchange_strong(
+                    expected, true, std::memory_order_acq_rel))
+                continue;
+
+            // Lanes are allocated the first time they're claimed,
+            // and kept around for whoever claims them next
+            EvBuf_t *lane = lanes[i].load(std::memory_order_acquire);
+            if (!lane) {
+                lane = new EvBuf_t;
+
+                if (!lane->Allocate(size) || !lane->EnableTimestamps()) {
+                    delete lane;
+                    claims->claimed[i].store(false, std::memory_order_release);
+                    return;
+                }
+
+                lane->SetOverflowPolicy(Policy());
+                lanes[i].store(lane, std::memory_order_release);
+            }
+
+            c.index = i;
+            c.lane = lane;
+            c.claims = claims;
+            return;
+        }
+
+        // Out of lanes, c.lane stays null and the fallback ring gets used
+    }
+
+    inline EvBufOverflow Policy() const {
+        return policy.load(std::memory_order_relaxed);
+    }
+
+  public:
+    LanedEvBuf_t() {}
+
+    LanedEvBuf_t(size_t ReqSize) { Allocate(ReqSize); }
+
+    ~LanedEvBuf_t() { Free(); }
+
+    // The size applies to each lane
+    bool Allocate(size_t ReqSize) override {
+        if (merged)
+            return false;
+
+        if (!fallback.Allocate(ReqSize) || !fallback.EnableTimestamps()) {
+            fallback.Free();
+            return false;
+        }
+
+        merged = new ShortEvent[EVBUF_MERGE_CHUNK];
+        mergedStamps = new uint64_t[EVBUF_MERGE_CHUNK];
+        mergedPos = mergedLen = 0;
+        direct = nullptr;
+
+        claims = std::make_shared<EvBufLaneClaims>();
+        size = ReqSize;
+
+        // Last, producers can write as soon as they see it
+        ringId.store(nextRingId.fetch_add(1, std::memory_order_relaxed),
+                     std::memory_order_release);
+
+        return true;
+    }
+
+    // Lanes always timestamp their events, this only decides whether
+    // the consumer gets to see the stamps
+    bool EnableTimestamps() {
+        timed = merged != nullptr;
+        return timed;
+    }
+
+    bool Free() override {
+        if (!merged)
+            return false;
+
+        // Any thread still holding a lane will claim a new one
+        // next time it writes to this ring
+        ringId.store(0, std::memory_order_release);
+        claims.reset();
+
+        for (size_t i = 0; i < EVBUF_MAX_LANES; i++)
+            delete lanes[i].exchange(nullptr, std::memory_order_acq_rel);
+
+        fallback.Free();
+        delete[] merged;
+        delete[] mergedStamps;
+        merged = nullptr;
+        mergedStamps = nullptr;
+        mergedPos = mergedLen = 0;
+        direct = nullptr;
+        timed = false;
+
+        size = 0;
+        return true;
+    }
+
+    void Write(uint8_t status, uint8_t param1, uint8_t param2) override {
+        Write(status | (param1 << 8) | (param2 << 16));
+    }
+
+    bool Write(uint32_t ev) override {
+        const uint64_t id = ringId.load(std::memory_order_acquire);
+
+        // Not allocated, or already freed
+        if (!id)
+            return false;
+
+        EvBufLane &c = laneCache.Find(id);
+        if (c.ringId != id)
+            ClaimLane(c, id);
+
+        if (c.lane)
+            return c.lane->Write(ev);
+
+        return fallback.Write(ev);
+    }
+
+    bool TryWrite(uint32_t ev, bool &retry) override {
+        const uint64_t id = ringId.load(std::memory_order_acquire);
+
+        retry = false;
+        if (!id)
+            return false;
+
+        EvBufLane &c = laneCache.Find(id);
+        if (c.ringId != id)
+            ClaimLane(c, id);
+
+        if (c.lane)
+            return c.lane->TryWrite(ev, retry);
+
+        return fallback.TryWrite(ev, retry);
+    }
+
+    // Events picked up by producers after the merge started may end up
+    // after newer events from other lanes, but only by the few nanoseconds
+    // between a producer taking the timestamp and publishing the event
+    std::span<ShortEvent> AcquireReadable() override {
+        struct Source {
+            BaseEvBuf_t *buf;
+            std::span<ShortEvent> evs;
+            uint64_t *stamps;
+            size_t used;
+        } src[EVBUF_MAX_LANES + 1];
+        size_t count = 0, backlog = 0;
+
+        if (mergedPos != mergedLen)
+            return {merged + mergedPos, mergedLen - mergedPos};
+
+        direct = nullptr;
+
+        for (size_t i = 0; i < EVBUF_MAX_LANES; i++) {
+            EvBuf_t *lane = lanes[i].load(std::memory_order_acquire);
+
+            if (!lane)
+                continue;
+
+            auto evs = lane->AcquireReadable();
+            if (!evs.empty())
+                src[count++] = {lane, evs, lane->ReadableStamps(), 0};
+
+            backlog += evs.size();
+        }
+
+        auto evs = fallback.AcquireReadable();
+        if (!evs.empty())
+            src[count++] = {&fallback, evs, fallback.ReadableStamps(), 0};
+
+        backlog += evs.size();
+        if (!count)
+            return {};
+
+        stats.Backlog(backlog);
+
+        if (count == 1) {
+            direct = src[0].buf;
+            return src[0].evs;
+        }
+
+        // Few sources, a linear scan for the oldest head is enough
+        mergedPos = mergedLen = 0;
+        while (mergedLen < EVBUF_MERGE_CHUNK) {
+            size_t oldest = count;
+            uint64_t oldestStamp = UINT64_MAX;
+
+            for (size_t i = 0; i < count; i++) {
+                Source &s = src[i];
+
+                if (s.used < s.evs.size() && s.stamps[s.used] < oldestStamp) {
+                    oldestStamp = s.stamps[s.used];
+                    oldest = i;
+                }
+            }
+
+            if (oldest == count)
+                break;
+
+            Source &s = src[oldest];
+            merged[mergedLen] = s.evs[s.used];
+            mergedStamps[mergedLen] = oldestStamp;
+            mergedLen++;
+            s.used++;
+        }
+
+        for (size_t i = 0; i < count; i++)
+            src[i].buf->Release(src[i].used);
+
+        return {merged, mergedLen};
+    }
+
+    void Release(size_t count) override {
+        if (!count)
+            return;
+
+        if (direct) {
+            stats.Dispatched(direct->ReadableStamps(), count, EvBufTime());
+            direct->Release(count);
+        } else {
+            stats.Dispatched(mergedStamps + mergedPos, count, EvBufTime());
+            mergedPos += count;
+        }
+    }
+
+    uint64_t *ReadableStamps() override {
+        if (!timed)
+            return nullptr;
+
+        return direct ? direct->ReadableStamps() : mergedStamps + mergedPos;
+    }
+
+    size_t ReadBatch(ShortEvent *out, size_t max) override {
+        size_t count = 0;
+
+        while (count < max) {
+            auto evs = AcquireReadable();
+
+            if (evs.empty())
+                break;
+
+            size_t n = evs.size() < max - count ? evs.size() : max - count;
+            memcpy(out + count, evs.data(), n * sizeof(ShortEvent));
+            Release(n);
+            count += n;
+        }
+
+        return count;
+    }
+
+    // The returned slot might be handed back to its producer,
+    // so it's only safe to dereference right away
+    ShortEvent *ReadPtr() override {
+        auto evs = AcquireReadable();
+
+        if (evs.empty())
+            return nullptr;
+
+        Release(1);
+        return evs.data();
+    }
+
+    ShortEvent Read() override {
+        auto evs = AcquireReadable();
+
+        if (evs.empty())
+            return 0;
+
+        ShortEvent ev = evs[0];
+        Release(1);
+
+        return ev;
+    }
+
+    ShortEvent *PeekPtr() override {
+        auto evs = AcquireReadable();
+        return evs.empty() ? nullptr : evs.data();
+    }
+
+    ShortEvent Peek() override {
+        auto val = PeekPtr();
+
+        if (val == nullptr)
+            return 0;
+
+        return *val;
+    }
+
+    void SetOverflowPolicy(EvBufOverflow policy) override {
+        this->policy.store(policy, std::memory_order_relaxed);
+
+        for (size_t i = 0; i < EVBUF_MAX_LANES; i++) {
+            if (EvBuf_t *lane = lanes[i].load(std::memory_order_acquire))
+                lane->SetOverflowPolicy(policy);
+        }
+
+        fallback.SetOverflowPolicy(policy);
+    }
+
+    void AddMetrics(EvBufMetrics &m) override {
+        for (size_t i = 0; i < EVBUF_MAX_LANES; i++) {
+            if (EvBuf_t *lane = lanes[i].load(std::memory_order_acquire))
+                lane->AddMetrics(m);
+        }
+
+        fallback.AddMetrics(m);
+        stats.AddTo(m);
+    }
+
+    bool NewEventsAvailable() override {
+        if (mergedPos != mergedLen)
+            return true;
+
+        for (size_t i = 0; i < EVBUF_MAX_LANES; i++) {
+            EvBuf_t *lane = lanes[i].load(std::memory_order_acquire);
+
+            if (lane && lane->NewEventsAvailable())
+                return true;
+        }
+
+        return fallback.NewEventsAvailable();
+    }
+
+    // Consumer side, drops whatever hasn't been read yet
+    void ResetHeads() override {
+        mergedPos = mergedLen = 0;
+        direct = nullptr;
+
+        for (size_t i = 0; i < EVBUF_MAX_LANES; i++) {
+            if (EvBuf_t *lane = lanes[i].load(std::memory_order_acquire))
+                lane->ResetHeads();
+        }
+
+        fallback.ResetHeads();
+    }
+
+    // Only meaningful for the fallback ring, lanes come and go
+    size_t GetReadHeadPos() override { return fallback.GetReadHeadPos(); }
+    size_t GetWriteHeadPos() override { return fallback.GetWriteHeadPos(); }
+};
+
+// Long events ring, for SysEx.
+// Messages are stored back to back as a 32-bit length followed by the data,
+// padded to 4 bytes, so an 11 bytes long GS reset takes 16 bytes of the ring.
+// Every message is contiguous in memory and can be read in place: with the
+// mirrored memory, a message can run past the end of the ring, otherwise
+// the producer leaves a wrap marker and starts over from the beginning.
+// Producers are serialized by a spinlock, SysEx is rare enough that it's
+// not worth the trouble of a lock-free multi-producer ring.
+// The ticket of a linked message is where its record starts in the ring,
+// in 4 bytes units, so that it fits in the 24 bits after the status byte.
+class LEvBuf_t final : public BaseEvBuf_t {
+  private:
+    static constexpr uint32_t WrapMarker = UINT32_MAX;
+    static constexpr uint32_t ConsumedFlag = 0x80000000;
+    static constexpr size_t HeaderSize = sizeof(uint32_t);
+    static constexpr size_t TicketUnit = 4;
+    static constexpr size_t MaxSize = TicketUnit << 24;
+
+    // Messages up to this size skip memcpy and take a fixed 16 bytes record
+    static constexpr size_t SmallMsgSize = 16 - HeaderSize;
+
+    EvBufMemory<uint8_t> mem;
+    uint8_t *buf = nullptr;
+    size_t mask = 0;
+    bool mirrored = false;
+
+    // Producers
+    alignas(EVBUF_CACHELINE) std::atomic_flag writeLock = ATOMIC_FLAG_INIT;
+    std::atomic<size_t> writeHead = 0;
+
+    // Consumer
+    alignas(EVBUF_CACHELINE) std::atomic<size_t> readHead = 0;
+
+    alignas(EVBUF_CACHELINE) char tailPad = 0;
+
+    static constexpr size_t RecordSize(size_t len) {
+        return len <= SmallMsgSize ? 16 : (HeaderSize + len + 3) & ~(size_t)3;
+    }
+
+    inline uint32_t GetLength(size_t head) {
+        uint32_t len = 0;
+        memcpy(&len, buf + (head & mask), HeaderSize);
+        return len;
+    }
+
+    inline void Lock() {
+        while (writeLock.test_and_set(std::memory_order_acquire)) {
+            while (writeLock.test(std::memory_order_relaxed))
+                std::this_thread::yield();
+        }
+    }
+
+    inline void Unlock() { writeLock.clear(std::memory_order_release); }
+
+    // Copies the message in the ring without publishing it, has to be
+    // called with the lock held. start is where its record begins, past
+    // the wrap marker if it needed one.
+    bool Store(uint8_t *ev, size_t len, size_t &start) {
+        if (!buf || !len || len > MAX_MIDIHDR_BUF)
+            return false;
+
+        const size_t recSize = RecordSize(len);
+        const uint32_t len32 = (uint32_t)len;
+
+        size_t curWriteHead = writeHead.load(std::memory_order_relaxed);
+        const size_t curReadHead = readHead.load(std::memory_order_acquire);
+        const size_t tail = size - (curWriteHead & mask);
+
+        // Without the mirror, a message that doesn't fit before the end of
+        // the ring costs whatever is left there too
+        const bool wrap = !mirrored && recSize > tail;
+        const size_t needed = wrap ? recSize + tail : recSize;
+
+        // Buffer full
+        if (size - (curWriteHead - curReadHead) < needed)
+            return false;
+
+        if (wrap) {
+            memcpy(buf + (curWriteHead & mask), &WrapMarker, HeaderSize);
+            curWriteHead += tail;
+        }
+
+        uint8_t *rec = buf + (curWriteHead & mask);
+
+        if (len <= SmallMsgSize) {
+            uint8_t small[16] = {0};
+
+            memcpy(small, &len32, HeaderSize);
+            for (size_t i = 0; i < len; i++)
+                small[HeaderSize + i] = ev[i];
+
+            memcpy(rec, small, sizeof(small));
+        } else {
+            memcpy(rec, &len32, HeaderSize);
+            memcpy(rec + HeaderSize, ev, len);
+        }
+
+        start = curWriteHead;
+        return true;
+    }
+
+  public:
+    LEvBuf_t() {}
+
+    LEvBuf_t(size_t ReqSize) { Allocate(ReqSize); }
+
+    ~LEvBuf_t() { Free(); }
+
+    bool Allocate(size_t ReqSize) override {
+        if (buf)
+            return false;
+
+        // There must always be room for the biggest message,
+        // plus whatever the wrap marker might waste without the mirror
+        const size_t minSize = RecordSize(MAX_MIDIHDR_BUF);
+
+        // Past MaxSize, the tickets wouldn't fit in a placeholder
+        if (ReqSize > MaxSize)
+            ReqSize = MaxSize;
+
+        size = mem.Allocate(ReqSize < minSize ? minSize : ReqSize);
+
+        if (size && !mem.IsMirrored() && size < minSize * 2) {
+            mem.Free();
+            size = mem.Allocate(minSize * 2);
+        }
+
+        if (!size)
+            return false;
+
+        buf = mem.Get();
+        mask = size - 1;
+        mirrored = mem.IsMirrored();
+
+        readHead.store(0, std::memory_order_relaxed);
+        writeHead.store(0, std::memory_order_release);
+
+        return true;
+    }
+
+    bool Free() override {
+        if (!buf)
+            return false;
+
+        readHead.store(0, std::memory_order_relaxed);
+        writeHead.store(0, std::memory_order_relaxed);
+
+        mem.Free();
+        buf = nullptr;
+
+        size = 0;
+        mask = 0;
+        return true;
+    }
+
+    bool Write(uint8_t *ev, size_t len) override {
+        size_t start = 0;
+
+        Lock();
+        const bool stored = Store(ev, len, start);
+        if (stored)
+            writeHead.store(start + RecordSize(len), std::memory_order_release);
+        Unlock();
+
+        return stored;
+    }
+
+    // The message is published before the placeholder is written, so the
+    // consumer always finds it, and taken back if the placeholder didn't
+    // make it. Both happen under the lock, so the placeholders of the
+    // different producers get stamped in the same order as their messages.
+    // The placeholder never waits for room with the lock held, if the
+    // events ring would have waited, the whole thing is retried after
+    // a backoff instead, so other producers aren't stuck behind this one.
+    bool WriteLinked(uint8_t *ev, size_t len, BaseEvBuf_t *events,
+                     uint8_t status) override {
+        uint32_t attempt = 0;
+        uint64_t deadline = 0;
+
+        for (;;) {
+            size_t start = 0;
+            bool retry = false;
+
+            Lock();
+            if (!Store(ev, len, start)) {
+                Unlock();
+                return false;
+            }
+
+            writeHead.store(start + RecordSize(len), std::memory_order_release);
+
+            const uint32_t ticket = (uint32_t)((start & mask) / TicketUnit);
+            if (events->TryWrite(status | (ticket << 8), retry)) {
+                Unlock();
+                return true;
+            }
+
+            // Nobody can have consumed it without the placeholder, only a
+            // wrap marker before it is kept, which the consumer skips anyway
+            writeHead.store(start, std::memory_order_release);
+            Unlock();
+
+            if (!retry || !EvBufBackoff(attempt, deadline))
+                return false;
+        }
+    }
+
+    // Walks the messages that are still pending, there are only ever a few
+    // of them, so that a placeholder that doesn't point to the start of one
+    // is ignored rather than read as garbage
+    std::span<uint8_t> AcquireLinked(uint32_t placeholder) override {
+        const size_t target = (size_t)(placeholder >> 8) * TicketUnit;
+        const size_t curWriteHead = writeHead.load(std::memory_order_acquire);
+        size_t head = readHead.load(std::memory_order_relaxed);
+
+        while (head < curWriteHead) {
+            const uint32_t len = GetLength(head);
+
+            if (len == WrapMarker) {
+                head += size - (head & mask);
+                continue;
+            }
+
+            if ((head & mask) == target) {
+                if (len & ConsumedFlag)
+                    break;
+
+                return {buf + target + HeaderSize, len};
+            }
+
+            head += RecordSize(len & ~ConsumedFlag);
+        }
+
+        return {};
+    }
+
+    // Has to follow a successful AcquireLinked(). Messages can be released
+    // out of order, the read head moves past every consumed one in a row.
+    void ReleaseLinked(uint32_t placeholder) override {
+        const size_t target = (size_t)(placeholder >> 8) * TicketUnit;
+        const uint32_t len = GetLength(target) | ConsumedFlag;
+        memcpy(buf + target, &len, HeaderSize);
+
+        const size_t curWriteHead = writeHead.load(std::memory_order_acquire);
+        size_t head = readHead.load(std::memory_order_relaxed);
+
+        while (head < curWriteHead) {
+            const uint32_t hlen = GetLength(head);
+
+            if (hlen == WrapMarker)
+                head += size - (head & mask);
+            else if (hlen & ConsumedFlag)
+                head += RecordSize(hlen & ~ConsumedFlag);
+            else
+                break;
+        }
+
+        readHead.store(head, std::memory_order_release);
+    }
+
+    std::span<uint8_t> AcquireLong() override {
+        size_t curReadHead = readHead.load(std::memory_order_relaxed);
+        const size_t curWriteHead = writeHead.load(std::memory_order_acquire);
+
+        if (curReadHead == curWriteHead)
+            return {};
+
+        uint32_t len = GetLength(curReadHead);
+
+        // A wrap marker is always followed by a message
+        if (len == WrapMarker) {
+            curReadHead += size - (curReadHead & mask);
+            readHead.store(curReadHead, std::memory_order_release);
+            len = GetLength(curReadHead);
+        }
+
+        return {buf + (curReadHead & mask) + HeaderSize, len};
+    }
+
+    // Has to follow a successful AcquireLong()
+    void ReleaseLong() override {
+        const size_t curReadHead = readHead.load(std::memory_order_relaxed);
+        readHead.store(curReadHead + RecordSize(GetLength(curReadHead)),
+                       std::memory_order_release);
+    }
+
+    void ReadLong(uint8_t *ev, size_t *len) override {
+        PeekLong(ev, len);
+
+        if (*len)
+            ReleaseLong();
+    }
+
+    void PeekLong(uint8_t *ev, size_t *len) override {
+        auto msg = AcquireLong();
+
+        if (!msg.empty())
+            memcpy(ev, msg.data(), msg.size());
+
+        *len = msg.size();
+    }
+
+    bool NewEventsAvailable() override {
+        return readHead.load(std::memory_order_relaxed) !=
+               writeHead.load(std::memory_order_acquire);
+    }
+
+    // Consumer side, drops whatever hasn't been read yet
+    void ResetHeads() override {
+        readHead.store(writeHead.load(std::memory_order_acquire),
+                       std::memory_order_release);
+    }
+
+    size_t GetReadHeadPos() override {
+        return readHead.load(std::memory_order_relaxed) & mask;
+    }
+    size_t GetWriteHeadPos() override {
+        return writeHead.load(std::memory_order_relaxed) & mask;
+    }
+};
+} // namespace OmniMIDI
+
+#endif
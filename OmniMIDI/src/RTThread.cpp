@@ -0,0 +1,194 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+#include "RTThread.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+// Every render thread goes through Promote(), one warning per process is
+// enough to know that the scheduler didn't let us in
+static std::atomic<bool> SchedWarned = false;
+static std::atomic<bool> AffinityWarned = false;
+
+std::vector<uint32_t>
+OmniMIDI::RTThread::ParseCPUSet(const std::string &spec) {
+    std::vector<uint32_t> cpus;
+    size_t pos = 0;
+
+    while (pos < spec.size()) {
+        size_t end = spec.find(',', pos);
+        if (end == std::string::npos)
+            end = spec.size();
+
+        std::string item = spec.substr(pos, end - pos);
+        pos = end + 1;
+
+        unsigned int first = 0, last = 0;
+        int fields = sscanf(item.c_str(), "%u-%u", &first, &last);
+        if (fields < 1)
+            continue;
+        if (fields == 1)
+            last = first;
+
+        for (uint32_t cpu = first; cpu <= last && cpu < RTTHREAD_MAX_CPUS;
+             cpu++) {
+            if (std::find(cpus.begin(), cpus.end(), cpu) == cpus.end())
+                cpus.push_back(cpu);
+        }
+    }
+
+    return cpus;
+}
+
+void OmniMIDI::RTThread::Promote(ErrorSystem::Logger *ErrLog,
+                                 const RTConfig &cfg, const char *name,
+                                 int32_t slot) {
+    if (cfg.Policy != RTNone) {
+#if defined(_WIN32)
+        // Windows has no real-time classes for a single thread, the closest
+        // thing is the top of the dynamic priority range
+        int prio = cfg.Priority >= 50 ? THREAD_PRIORITY_TIME_CRITICAL
+                                      : THREAD_PRIORITY_HIGHEST;
+        if (!SetThreadPriority(GetCurrentThread(), prio)) {
+            if (!SchedWarned.exchange(true)) {
+                Message("%s >> SetThreadPriority failed (%lu), the thread "
+                        "will keep its default priority.",
+                        name, GetLastError());
+            }
+        }
+#else
+        int policy = cfg.Policy == RTFifo ? SCHED_FIFO : SCHED_RR;
+        int prio = std::clamp((int)cfg.Priority, sched_get_priority_min(policy),
+                              sched_get_priority_max(policy));
+
+        // Without CAP_SYS_NICE, RLIMIT_RTPRIO is the ceiling. A lower
+        // real-time priority still beats SCHED_OTHER, so use that instead
+        // of giving up.
+        struct rlimit lim;
+        if (getrlimit(RLIMIT_RTPRIO, &lim) == 0 && lim.rlim_cur > 0 &&
+            lim.rlim_cur != RLIM_INFINITY && (rlim_t)prio > lim.rlim_cur)
+            prio = (int)lim.rlim_cur;
+
+        struct sched_param param = {};
+        param.sched_priority = prio;
+
+        int err = pthread_setschedparam(pthread_self(), policy, &param);
+        if (err) {
+            if (!SchedWarned.exchange(true)) {
+                Message("%s >> Real-time scheduling unavailable (%s), the "
+                        "thread will stay in SCHED_OTHER. Grant "
+                        "CAP_SYS_NICE or raise RLIMIT_RTPRIO to enable it.",
+                        name, strerror(err));
+            }
+        }
+#endif
+    }
+
+    if (cfg.CPUs.empty())
+        return;
+
+    size_t first = 0, count = cfg.CPUs.size();
+    if (slot >= 0) {
+        first = slot % cfg.CPUs.size();
+        count = 1;
+    }
+
+#if defined(_WIN32)
+    DWORD_PTR mask = 0;
+    for (size_t i = first; i < first + count; i++) {
+        if (cfg.CPUs[i] < sizeof(DWORD_PTR) * 8)
+            mask |= (DWORD_PTR)1 << cfg.CPUs[i];
+    }
+
+    if (!mask || !SetThreadAffinityMask(GetCurrentThread(), mask)) {
+        if (!AffinityWarned.exchange(true)) {
+            Message("%s >> SetThreadAffinityMask failed (%lu), the thread "
+                    "can run on any CPU.",
+                    name, GetLastError());
+        }
+    }
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (size_t i = first; i < first + count; i++) {
+        if (cfg.CPUs[i] < CPU_SETSIZE)
+            CPU_SET(cfg.CPUs[i], &set);
+    }
+
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err) {
+        if (!AffinityWarned.exchange(true)) {
+            Message("%s >> pthread_setaffinity_np failed (%s), the thread "
+                    "can run on any CPU.",
+                    name, strerror(err));
+        }
+    }
+#else
+    if (!AffinityWarned.exchange(true)) {
+        Message("%s >> CPU affinity isn't supported on this platform.", name);
+    }
+#endif
+}
+
+bool OmniMIDI::RTThread::LockMemory(ErrorSystem::Logger *ErrLog) {
+#if defined(_WIN32)
+    Message("Memory locking isn't supported on Windows, skipping.");
+    return false;
+#else
+    if (mlockall(MCL_CURRENT) != 0) {
+        Message("mlockall failed (%s), memory will stay pageable. Raise "
+                "RLIMIT_MEMLOCK to enable it.",
+                strerror(errno));
+        return false;
+    }
+
+    Message("Process memory locked.");
+    return true;
+#endif
+}
+
+void OmniMIDI::RTThread::Prefault(void *ptr, size_t len) {
+    if (!ptr || !len)
+        return;
+
+#if defined(_WIN32)
+    const size_t page = 4096;
+#else
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+
+    // A read would only map the shared zero page, it has to be a write
+    volatile char *bytes = (volatile char *)ptr;
+    for (size_t i = 0; i < len; i += page)
+        bytes[i] = bytes[i];
+    bytes[len - 1] = bytes[len - 1];
+}
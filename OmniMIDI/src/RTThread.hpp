@@ -0,0 +1,77 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+#ifndef _RTTHREAD_H
+#define _RTTHREAD_H
+
+#pragma once
+
+#include "ErrSys.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Anything past this in an affinity list gets ignored
+#define RTTHREAD_MAX_CPUS 1024
+
+namespace OmniMIDI {
+enum RTSchedPolicy {
+    RTNone = 0,       // Leave the scheduler alone
+    RTFifo = 1,       // SCHED_FIFO
+    RTRoundRobin = 2, // SCHED_RR
+    RTPOLICY_COUNT = RTRoundRobin
+};
+
+// How the render threads should be scheduled, see SettingsModule
+struct RTConfig {
+    uint32_t Policy = RTNone;
+    int32_t Priority = 0;
+    std::vector<uint32_t> CPUs;
+    bool LockMemory = false;
+};
+
+// Real-time scheduling helpers for the threads on the audio path.
+// None of them is fatal: without the rights to do something (no
+// CAP_SYS_NICE or RLIMIT_RTPRIO/RLIMIT_MEMLOCK on Linux), the thread keeps
+// running as it was, and the failure gets logged once per process.
+class RTThread {
+  public:
+    // Parses a CPU list like "0-3,6", whatever doesn't parse is skipped
+    static std::vector<uint32_t> ParseCPUSet(const std::string &spec);
+
+    // Applies the policy and affinity to the calling thread. With a slot,
+    // the thread is pinned to a single CPU of the set, slot % size, so a
+    // pool of workers spreads across it. Without one (-1), it can run on
+    // any CPU of the set.
+    static void Promote(ErrorSystem::Logger *ErrLog, const RTConfig &cfg,
+                        const char *name, int32_t slot = -1);
+
+    // Locks the pages the process has mapped right now in RAM. Future
+    // mappings are left alone on purpose, with MCL_FUTURE any allocation
+    // past RLIMIT_MEMLOCK would fail, soundfont loading included.
+    static bool LockMemory(ErrorSystem::Logger *ErrLog);
+
+    // Touches every page of a buffer, so that the first write from the
+    // audio path doesn't page fault
+    static void Prefault(void *ptr, size_t len);
+};
+} // namespace OmniMIDI
+
+#endif
@@ -368,6 +368,15 @@ uint32_t OMShared::Funcs::QuerySystemTime(int64_t *v) {
 #endif
 }
 
+// Milliseconds on a clock that never goes back, cheap enough to be read
+// for every event
+uint64_t OMShared::Funcs::MonotonicMs() {
+    using namespace std::chrono;
+
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch())
+        .count();
+}
+
 bool OMShared::Funcs::GetFolderPath(const FIDs FolderID, char *path,
                                     size_t szPath) {
     if (path == nullptr)
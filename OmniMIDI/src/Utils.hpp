@@ -159,6 +159,7 @@ class Funcs {
     ~Funcs();
 
     static void PreciseSleep(int64_t microseconds);
+    static uint64_t MonotonicMs();
     void MicroSleep(int64_t v);
     uint32_t QuerySystemTime(int64_t *v);
 
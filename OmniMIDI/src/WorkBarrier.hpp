@@ -0,0 +1,136 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+#ifndef _WORKBARRIER_H
+#define _WORKBARRIER_H
+
+#pragma once
+
+#include "Common.hpp"
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#define WORKBARRIER_CACHELINE 64
+
+// How many times a waiter can spin before going to sleep, it adapts
+// between these two depending on how the previous waits went
+#define WORKBARRIER_MIN_SPIN 16
+#define WORKBARRIER_MAX_SPIN 16384
+
+namespace OmniMIDI {
+// Fork/join barrier for a fixed pool of worker threads.
+// The dispatcher starts a round by bumping the generation counter, each
+// worker counts down remaining when it's done, and the last one wakes the
+// dispatcher up. No lock is ever taken: waiters spin for a bit, then sleep
+// on the counter itself (futex on Linux, WaitOnAddress on Windows).
+class WorkBarrier {
+  public:
+    // Spin budget of a waiter, each thread keeps its own
+    struct Spinner {
+        uint32_t budget = WORKBARRIER_MIN_SPIN;
+    };
+
+  private:
+    alignas(WORKBARRIER_CACHELINE) std::atomic<uint32_t> generation = 0;
+    alignas(WORKBARRIER_CACHELINE) std::atomic<uint32_t> remaining = 0;
+    alignas(WORKBARRIER_CACHELINE) uint32_t workers = 0;
+    bool exiting = false;
+
+    // Spinning on a single core only delays whoever we're waiting for
+    bool canSpin = std::thread::hardware_concurrency() > 1;
+
+    // Spins until done() is true or the budget runs out. The budget grows
+    // when spinning pays off and shrinks when it doesn't.
+    template <class F> bool Spin(Spinner &s, F done) {
+        for (uint32_t i = 0; canSpin && i < s.budget; i++) {
+            if (done()) {
+                if (s.budget < WORKBARRIER_MAX_SPIN)
+                    s.budget *= 2;
+
+                return true;
+            }
+
+            CPU_PAUSE();
+        }
+
+        if (s.budget > WORKBARRIER_MIN_SPIN)
+            s.budget /= 2;
+
+        return done();
+    }
+
+  public:
+    // Dispatcher
+    // Has to be called before the workers start
+    void SetWorkers(uint32_t count) { workers = count; }
+
+    // Starts a new round, anything written before this call is visible
+    // to the workers once they wake up
+    void Dispatch() {
+        remaining.store(workers, std::memory_order_relaxed);
+        generation.fetch_add(1, std::memory_order_release);
+        generation.notify_all();
+    }
+
+    // Waits for every worker to be done with the current round
+    void Wait(Spinner &s) {
+        if (Spin(s, [&] {
+                return remaining.load(std::memory_order_acquire) == 0;
+            }))
+            return;
+
+        uint32_t left;
+        while ((left = remaining.load(std::memory_order_acquire)) != 0)
+            remaining.wait(left, std::memory_order_acquire);
+    }
+
+    // Wakes the workers up for good, WaitWork() returns false from now on
+    void Shutdown() {
+        exiting = true;
+        generation.fetch_add(1, std::memory_order_release);
+        generation.notify_all();
+    }
+
+    // Workers
+    // Waits for the round after seen, returns false if it's time to exit
+    bool WaitWork(uint32_t &seen, Spinner &s) {
+        uint32_t cur = seen;
+
+        if (!Spin(s, [&] {
+                return (cur = generation.load(std::memory_order_acquire)) !=
+                       seen;
+            })) {
+            while ((cur = generation.load(std::memory_order_acquire)) == seen)
+                generation.wait(seen, std::memory_order_acquire);
+        }
+
+        seen = cur;
+        return !exiting;
+    }
+
+    // Marks this worker as done with the current round
+    void Arrive() {
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            remaining.notify_one();
+    }
+};
+} // namespace OmniMIDI
+
+#endif
@@ -19,7 +19,6 @@
 
 #include "AudioPlayer.hpp"
 #include <stdexcept>
-#include <vector>
 
 #define MINIAUDIO_IMPLEMENTATION
 #include <miniaudio.h>
@@ -33,33 +32,40 @@ void data_callback(ma_device *pDevice, void *pOutput, const void *pInput,
     MIDIAudioPlayer::AudioPlayerArgument *argument =
         (MIDIAudioPlayer::AudioPlayerArgument *)pDevice->pUserData;
 
-    MIDIAudioPlayer::AudioPipe audio_pipe = argument->audio_pipe;
-
-    AudioLimiter *limiter = argument->limiter;
+    if (!argument->thread_ready) {
+        argument->thread_ready = true;
+        if (argument->thread_init)
+            argument->thread_init();
+    }
 
+    // Rendered and limited in place, no allocations and no copies on the
+    // device thread
     float *out = (float *)pOutput;
-    std::vector<float> outVec(frameCount * argument->render_channels);
-    audio_pipe(outVec);
-    if (limiter) {
-        limiter->process(outVec);
-    }
+    argument->audio_pipe(out, frameCount);
 
-    std::copy(outVec.begin(), outVec.end(), out);
+    if (argument->limiter) {
+        argument->limiter->process(out, frameCount);
+    }
 }
 
 OmniMIDI::MIDIAudioPlayer::MIDIAudioPlayer(ErrorSystem::Logger *PErr,
                                            uint32_t sample_rate,
                                            uint16_t channels,
                                            bool enable_limiter,
-                                           AudioPipe audio_pipe)
+                                           AudioPipe audio_pipe,
+                                           ThreadInit thread_init)
     : ErrLog(PErr) {
 
     arg.audio_pipe = audio_pipe;
+    arg.thread_init = thread_init;
+    arg.thread_ready = false;
     arg.limiter = NULL;
     arg.render_channels = channels;
     arg.device_channels = channels;
     if (enable_limiter) {
         arg.limiter = new AudioLimiter(channels, sample_rate);
+        Message("Audio limiter enabled (%s), %u frames of lookahead.",
+                AudioLimiter::KernelName(), arg.limiter->Latency());
     }
 
     ma_device_config config = ma_device_config_init(ma_device_type_playback);
@@ -83,6 +89,10 @@ OmniMIDI::MIDIAudioPlayer::~MIDIAudioPlayer() {
 
     ma_device_uninit(&device);
 
+    // The device thread is gone, drop the init function here rather than
+    // from the callback
+    arg.thread_init = nullptr;
+
     if (arg.limiter)
         delete arg.limiter;
 
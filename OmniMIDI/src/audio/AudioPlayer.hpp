@@ -31,18 +31,28 @@ namespace OmniMIDI {
 
 class MIDIAudioPlayer {
   public:
-    using AudioPipe = std::function<void(std::vector<float> &)>;
+    // Fills frames frames of interleaved samples straight into the
+    // device's buffer, from its real time thread
+    using AudioPipe = std::function<void(float *buffer, size_t frames)>;
+    using ThreadInit = std::function<void()>;
 
     struct AudioPlayerArgument {
         uint16_t render_channels;
         uint16_t device_channels;
         AudioPipe audio_pipe;
         AudioLimiter *limiter;
+
+        // The device thread belongs to miniaudio, so this runs from
+        // the first callback. It's only flagged as done there, the
+        // function and what it captured are freed with the player, off
+        // the device thread
+        ThreadInit thread_init;
+        bool thread_ready;
     };
 
     MIDIAudioPlayer(ErrorSystem::Logger *PErr, uint32_t sample_rate,
                     uint16_t channels, bool enable_limiter,
-                    AudioPipe audio_pipe);
+                    AudioPipe audio_pipe, ThreadInit thread_init = nullptr);
     ~MIDIAudioPlayer();
 
   private:
@@ -18,13 +18,18 @@
  */
 
 #include "BufferedRenderer.hpp"
+#include "../RTThread.hpp"
 #include "../Utils.hpp"
 #include <chrono>
-#include <mutex>
-#include <numeric>
+#include <cstring>
+#include <stdexcept>
 
+// The render thread decides from this whether it can overwrite what's
+// behind the read head, so it has to see the device thread's copies out
+// of the ring done first: acquire, to pair with release()
 int64_t BufferedRenderer::samples() const {
-    return stats_.samples->load(std::memory_order_relaxed);
+    return (int64_t)(write_head_.load(std::memory_order_relaxed) -
+                     read_head_.load(std::memory_order_acquire));
 }
 
 int64_t BufferedRenderer::last_samples_after_read() const {
@@ -39,39 +44,88 @@ size_t BufferedRenderer::render_size() const {
     return stats_.render_size->load(std::memory_order_relaxed);
 }
 
+uint32_t BufferedRenderer::read_ahead() const {
+    return read_ahead_.load(std::memory_order_relaxed);
+}
+
 double BufferedRenderer::average_renderer_load() const {
-    std::shared_lock<std::shared_mutex> lock(*stats_.render_time_mutex);
-    if (stats_.render_time_queue->empty()) {
+    const RenderTimes &times = *stats_.render_times;
+    const size_t count = std::min(
+        times.written.load(std::memory_order_acquire), RenderTimesCount);
+    if (!count) {
         return 0.0;
     }
-    double sum = std::accumulate(stats_.render_time_queue->begin(),
-                                 stats_.render_time_queue->end(), 0.0);
-    return sum / stats_.render_time_queue->size();
+    double sum = 0.0;
+    for (size_t i = 0; i < count; i++)
+        sum += times.loads[i].load(std::memory_order_relaxed);
+    return sum / count;
 }
 
 double BufferedRenderer::last_renderer_load() const {
-    std::shared_lock<std::shared_mutex> lock(*stats_.render_time_mutex);
-    if (stats_.render_time_queue->empty()) {
+    const RenderTimes &times = *stats_.render_times;
+    const size_t written = times.written.load(std::memory_order_acquire);
+    if (!written) {
         return 0.0;
     }
-    return stats_.render_time_queue->front();
+    return times.loads[(written - 1) % RenderTimesCount].load(
+        std::memory_order_relaxed);
+}
+
+uint64_t BufferedRenderer::underruns() const {
+    return underruns_.load(std::memory_order_relaxed);
+}
+
+uint64_t BufferedRenderer::late_samples() const {
+    return late_samples_.load(std::memory_order_relaxed);
+}
+
+void BufferedRenderer::get_metrics(AudioMetrics &m) const {
+    m.Reads = reads_.load(std::memory_order_relaxed);
+    m.Underruns = underruns();
+    m.LateSamples = late_samples();
+    m.Buffered = (uint64_t)last_samples_after_read();
+    m.RenderSize = render_size();
 }
 
 // --- BufferedRenderer Implementation ---
 
 BufferedRenderer::BufferedRenderer(AudioPipe render_function,
                                    AudioStreamParams params,
-                                   size_t initial_render_size)
-    : stream_params_(params), audio_pipe_(std::move(render_function)) {
+                                   size_t initial_render_size,
+                                   ThreadInit thread_init, AutoTune tune)
+    : stream_params_(params), audio_pipe_(std::move(render_function)),
+      thread_init_(std::move(thread_init)) {
+
+    tune_ = tune;
+    max_render_size_ = std::max(tune_.max_size, initial_render_size);
+    tune_.min_size = std::max(tune_.min_size, (size_t)1);
+
+    // Everything the render thread and the device thread touch is allocated
+    // here, and only here
+    const size_t block = max_render_size_ * stream_params_.channels;
+    ring_size_ = ring_mem_.Allocate(block * BUFFERED_RENDERER_BLOCKS);
+    if (!ring_size_)
+        throw std::runtime_error("Failed to allocate the sample ring!");
+
+    ring_ = ring_mem_.Get();
+    ring_mask_ = ring_size_ - 1;
+    ring_mirrored_ = ring_mem_.IsMirrored();
+
+    if (!ring_mirrored_)
+        scratch_.resize(block);
+
+    // Fault the ring in while nobody else touches it, both views of it if
+    // it's mirrored, so the first lap of the render thread doesn't page
+    // fault. resize() already zeroed the scratch block
+    OmniMIDI::RTThread::Prefault(ring_, ring_size_ * sizeof(float) *
+                                            (ring_mirrored_ ? 2 : 1));
 
     // Initialize the shared statistics
-    stats_.samples = std::make_shared<std::atomic<int64_t>>(0);
     stats_.last_samples_after_read = std::make_shared<std::atomic<int64_t>>(0);
     stats_.last_request_samples = std::make_shared<std::atomic<int64_t>>(0);
     stats_.render_size =
         std::make_shared<std::atomic<size_t>>(initial_render_size);
-    stats_.render_time_queue = std::make_shared<std::deque<double>>();
-    stats_.render_time_mutex = std::make_shared<std::shared_mutex>();
+    stats_.render_times = std::make_shared<RenderTimes>();
 
     killed_ = std::make_shared<std::atomic<bool>>(false);
 
@@ -87,58 +141,143 @@ BufferedRenderer::~BufferedRenderer() {
     }
 }
 
-void BufferedRenderer::read(std::vector<float> &dest) {
-    std::fill(dest.begin(), dest.end(), 0.0f);
+// Without the mirror, a run that wraps around the end of the ring stops
+// there, and the rest comes with the next call
+std::span<const float> BufferedRenderer::acquire(size_t max) {
+    const size_t read_head = read_head_.load(std::memory_order_relaxed);
+    const size_t pos = read_head & ring_mask_;
+    size_t avail = write_head_.load(std::memory_order_acquire) - read_head;
 
-    stats_.samples->fetch_sub(dest.size(), std::memory_order_seq_cst);
-    stats_.last_request_samples->store(dest.size(), std::memory_order_seq_cst);
+    if (!ring_mirrored_)
+        avail = std::min(avail, ring_size_ - pos);
 
-    size_t filled_count = 0;
+    return {ring_ + pos, std::min(avail, max)};
+}
 
-    // 1. Read from the remainder buffer first
-    size_t to_copy_from_remainder = std::min(dest.size(), remainder_.size());
-    if (to_copy_from_remainder > 0) {
-        std::copy(remainder_.begin(),
-                  remainder_.begin() + to_copy_from_remainder, dest.begin());
-        remainder_.erase(remainder_.begin(),
-                         remainder_.begin() + to_copy_from_remainder);
-        filled_count += to_copy_from_remainder;
+void BufferedRenderer::release(size_t count) {
+    read_head_.store(read_head_.load(std::memory_order_relaxed) + count,
+                     std::memory_order_release);
+}
+
+// Linear ramp over the first (in) or last (out) frames of buffer
+void BufferedRenderer::fade(float *buffer, size_t frames, bool in) {
+    const size_t channels = stream_params_.channels;
+    const size_t len = std::min(frames, (size_t)BUFFERED_RENDERER_FADE);
+    float *start = in ? buffer : buffer + (frames - len) * channels;
+
+    for (size_t f = 0; f < len; f++) {
+        const float gain = in ? (float)f / len : (float)(len - f) / len;
+
+        for (size_t c = 0; c < channels; c++)
+            start[f * channels + c] *= gain;
     }
+}
 
-    // 2. Read from the queue until the destination is full
-    while (filled_count < dest.size()) {
-        std::vector<float> received_buf;
+void BufferedRenderer::read(float *dest, size_t count) {
+    const size_t channels = stream_params_.channels;
 
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            queue_cond.wait(lock, [this] { return !receive_queue_.empty(); });
-            received_buf = std::move(receive_queue_.front());
-            receive_queue_.pop();
-        }
+    stats_.last_request_samples->store(count, std::memory_order_relaxed);
+    reads_.store(reads_.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_relaxed);
+
+    // Without the mirror, the ready samples can come in two parts
+    size_t filled = 0;
+    for (int part = 0; part < 2 && filled < count; part++) {
+        std::span<const float> avail = acquire(count - filled);
+        if (avail.empty())
+            break;
 
-        size_t needed = dest.size() - filled_count;
-        size_t to_copy_from_new = std::min(needed, received_buf.size());
+        memcpy(dest + filled, avail.data(), avail.size_bytes());
+        filled += avail.size();
+        release(avail.size());
+    }
 
-        std::copy(received_buf.begin(), received_buf.begin() + to_copy_from_new,
-                  dest.begin() + filled_count);
-        filled_count += to_copy_from_new;
+    if (filled) {
+        primed_ = true;
 
-        // If there are leftover samples, save them as the new remainder
-        if (to_copy_from_new < received_buf.size()) {
-            remainder_.assign(received_buf.begin() + to_copy_from_new,
-                              received_buf.end());
+        if (faded_out_) {
+            fade(dest, filled / channels, true);
+            faded_out_ = false;
         }
     }
 
-    stats_.last_samples_after_read->store(stats_.samples->load(),
+    // The render thread is late, play silence instead of waiting for it
+    if (filled < count) {
+        if (primed_) {
+            underruns_.store(underruns_.load(std::memory_order_relaxed) + 1,
+                             std::memory_order_relaxed);
+            late_samples_.store(late_samples_.load(std::memory_order_relaxed) +
+                                    (count - filled),
+                                std::memory_order_relaxed);
+        }
+
+        if (filled)
+            fade(dest, filled / channels, false);
+
+        memset(dest + filled, 0, (count - filled) * sizeof(float));
+        faded_out_ = true;
+    }
+
+    stats_.last_samples_after_read->store(samples(),
                                           std::memory_order_relaxed);
 }
 
 void BufferedRenderer::set_render_size(size_t size) {
-    stats_.render_size->store(size, std::memory_order_seq_cst);
+    // The ring was sized for max_render_size_
+    stats_.render_size->store(std::min(size, max_render_size_),
+                              std::memory_order_seq_cst);
+}
+
+// Runs every BUFFERED_RENDERER_TUNE_MS of rendered audio. The load is the
+// time spent rendering over the audio it gave, so 1.0 means the render
+// thread only just keeps up
+void BufferedRenderer::tune() {
+    const double load = tune_busy_ / tune_span_;
+    const uint64_t underruns = this->underruns();
+    const bool underran = underruns != tune_underruns_;
+    const double bias = std::min(tune_.bias, 100u) / 100.0;
+
+    tune_busy_ = 0.0;
+    tune_span_ = 0.0;
+    tune_underruns_ = underruns;
+
+    // Latency first grows past 90% load, safety first past 60%, and only
+    // shrinks after 0.25s to 2.75s of low load
+    const double high = 0.9 - 0.3 * bias;
+    const double low = high / 2;
+    const uint32_t calm = 1 + tune_.bias / 10;
+
+    size_t size = render_size();
+    uint32_t ahead = read_ahead();
+
+    if (underran || load > high) {
+        size = std::min(size + std::max(size / 4, (size_t)1), tune_.max_size);
+
+        // Underruns mean the device reads in bigger bursts than expected,
+        // a bigger block alone won't do
+        if (underran)
+            ahead = std::min(ahead + 20,
+                             (uint32_t)BUFFERED_RENDERER_READ_AHEAD_MAX);
+
+        tune_calm_ = 0;
+    } else if (load < low && ++tune_calm_ >= calm) {
+        size = std::max(size - size / 8, tune_.min_size);
+        ahead = std::max(ahead - 5, (uint32_t)BUFFERED_RENDERER_READ_AHEAD);
+
+        // Keep shrinking every run while it stays calm
+        tune_calm_ = calm - 1;
+    } else if (load >= low) {
+        tune_calm_ = 0;
+    }
+
+    set_render_size(size);
+    read_ahead_.store(ahead, std::memory_order_relaxed);
 }
 
 void BufferedRenderer::render_loop() {
+    if (thread_init_)
+        thread_init_();
+
     while (!killed_->load(std::memory_order_relaxed)) {
         size_t size = stats_.render_size->load(std::memory_order_seq_cst);
         if (size == 0) {
@@ -146,18 +285,23 @@ void BufferedRenderer::render_loop() {
             continue;
         }
 
+        const size_t count = size * stream_params_.channels;
+
         // The expected render time per iteration, with a 10% buffer.
         auto delay_micros =
             (1000000LL * size / stream_params_.sample_rate) * 90 / 100;
         auto delay = std::chrono::microseconds(delay_micros);
 
-        // If the render thread is too far ahead, wait a bit.
+        // If the render thread is too far ahead, or the ring has no room
+        // for another block, wait a bit.
         while (!killed_->load(std::memory_order_relaxed)) {
-            auto current_samples =
-                stats_.samples->load(std::memory_order_seq_cst);
+            auto current_samples = samples();
             auto last_requested =
-                stats_.last_request_samples->load(std::memory_order_seq_cst);
-            if (current_samples > last_requested * 110 / 100) {
+                stats_.last_request_samples->load(std::memory_order_relaxed);
+            if (current_samples >
+                    last_requested * read_ahead_.load(
+                                         std::memory_order_relaxed) / 100 ||
+                ring_size_ - (size_t)current_samples < count) {
                 std::this_thread::sleep_for(delay / 10);
             } else {
                 break;
@@ -169,19 +313,26 @@ void BufferedRenderer::render_loop() {
 
         auto start_time = std::chrono::high_resolution_clock::now();
 
-        // Create the buffer and render samples into it
-        std::vector<float> buffer(size * stream_params_.channels, 0.0f);
-        audio_pipe_(buffer);
-
-        // Send the rendered samples to the main thread
-        stats_.samples->fetch_add(buffer.size(), std::memory_order_seq_cst);
-
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex);
-            receive_queue_.push(std::move(buffer));
-            queue_cond.notify_one();
+        // Render straight into the ring, unless the block would wrap
+        // around its end
+        const size_t write_head = write_head_.load(std::memory_order_relaxed);
+        const size_t pos = write_head & ring_mask_;
+        const bool wraps = !ring_mirrored_ && pos + count > ring_size_;
+
+        if (wraps) {
+            const size_t first = ring_size_ - pos;
+
+            audio_pipe_(scratch_.data(), count);
+            memcpy(ring_ + pos, scratch_.data(), first * sizeof(float));
+            memcpy(ring_, scratch_.data() + first,
+                   (count - first) * sizeof(float));
+        } else {
+            audio_pipe_(ring_ + pos, count);
         }
 
+        // Hand the block over to the device thread
+        write_head_.store(write_head + count, std::memory_order_release);
+
         // Record the render time statistic
         {
             auto elapsed =
@@ -189,13 +340,21 @@ void BufferedRenderer::render_loop() {
             double elapsed_f64 = std::chrono::duration<double>(elapsed).count();
             double total_f64 = std::chrono::duration<double>(delay).count();
 
-            std::unique_lock<std::shared_mutex> lock(*stats_.render_time_mutex);
-            stats_.render_time_queue->push_front(elapsed_f64 / total_f64);
-            if (stats_.render_time_queue->size() > 100) {
-                stats_.render_time_queue->pop_back();
-            }
+            RenderTimes &times = *stats_.render_times;
+            const size_t written =
+                times.written.load(std::memory_order_relaxed);
+            times.loads[written % RenderTimesCount].store(
+                elapsed_f64 / total_f64, std::memory_order_relaxed);
+            times.written.store(written + 1, std::memory_order_release);
+
+            tune_busy_ += elapsed_f64;
+            tune_span_ += (double)size / stream_params_.sample_rate;
         }
 
+        if (tune_.max_size > tune_.min_size &&
+            tune_span_ * 1000.0 >= BUFFERED_RENDERER_TUNE_MS)
+            tune();
+
         // Sleep until the next iteration is due
         auto end_time = start_time + delay;
         auto now = std::chrono::high_resolution_clock::now();
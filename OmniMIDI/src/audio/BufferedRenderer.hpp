@@ -24,46 +24,127 @@
 // https://github.com/BlackMIDIDevs/xsynth/blob/master/core/src/buffered_renderer.rs
 // Written by arduano
 
+#include <array>
 #include <atomic>
-#include <condition_variable>
-#include <deque>
 #include <functional>
 #include <memory>
-#include <queue>
-#include <shared_mutex>
+#include <span>
 #include <thread>
 #include <vector>
 
 #include "../Common.hpp"
+#include "../EvBuf_t.hpp"
+
+// Blocks of the largest render size the sample ring can hold. The render
+// thread only stays about a device period ahead, so this is plenty
+#define BUFFERED_RENDERER_BLOCKS 8
+
+// Frames faded out before the gap left by an underrun, and faded back in
+// once the samples come back, so it doesn't click
+#define BUFFERED_RENDERER_FADE 32
+
+// How far ahead of the device the render thread stays, in percent of the
+// last read. The automatic tuning moves it up to the max on underruns
+#define BUFFERED_RENDERER_READ_AHEAD 110
+#define BUFFERED_RENDERER_READ_AHEAD_MAX 300
+
+// Audio rendered between two runs of the automatic tuning (ms)
+#define BUFFERED_RENDERER_TUNE_MS 250
 
 class BufferedRenderer {
-    using AudioPipe = std::function<void(std::vector<float> &)>;
+    // Has to fill all of buffer, count is in samples
+    using AudioPipe = std::function<void(float *buffer, size_t count)>;
+    using ThreadInit = std::function<void()>;
+
+  public:
+    // Lets the render thread pick its own render size within
+    // [min_size, max_size] frames, and its read-ahead with it, off when
+    // max_size isn't past min_size. It grows them when its load gets high
+    // or the device underruns, and shrinks them back toward min_size when
+    // there's headroom. bias goes from 0 (latency first: grow late, shrink
+    // as soon as possible) to 100 (safety first: grow early, hold on to
+    // the bigger size for a few seconds)
+    struct AutoTune {
+        size_t min_size;
+        size_t max_size;
+        uint32_t bias;
+    };
 
   private:
+    // The last RenderTimesCount render loads. Only the render thread
+    // writes, into slot written % RenderTimesCount, then publishes the new
+    // count; readers can catch a slot being overwritten, which only skews
+    // the statistic
+    static constexpr size_t RenderTimesCount = 100;
+    struct RenderTimes {
+        std::array<std::atomic<double>, RenderTimesCount> loads{};
+        std::atomic<size_t> written{0};
+    };
+
     struct BufferedRendererStats {
-        std::shared_ptr<std::atomic<int64_t>> samples;
         std::shared_ptr<std::atomic<int64_t>> last_samples_after_read;
         std::shared_ptr<std::atomic<int64_t>> last_request_samples;
-        std::shared_ptr<std::deque<double>> render_time_queue;
-        std::shared_ptr<std::shared_mutex> render_time_mutex;
+        std::shared_ptr<RenderTimes> render_times;
         std::shared_ptr<std::atomic<size_t>> render_size;
     };
 
     void render_loop();
 
     BufferedRendererStats stats_;
-    std::queue<std::vector<float>> receive_queue_;
-    std::mutex queue_mutex;
-    std::condition_variable queue_cond;
-    std::vector<float> remainder_;
+
+    // Rendered samples waiting for read(), the render thread is the only
+    // producer and the device thread the only consumer. The heads are free
+    // running sample counts, masked into the ring. Mirrored the same way as
+    // the event rings where possible, see EvBufMemory
+    OmniMIDI::EvBufMemory<float> ring_mem_;
+    float *ring_ = nullptr;
+    size_t ring_size_ = 0;
+    size_t ring_mask_ = 0;
+    bool ring_mirrored_ = false;
+    alignas(EVBUF_CACHELINE) std::atomic<size_t> write_head_ = 0;
+    alignas(EVBUF_CACHELINE) std::atomic<size_t> read_head_ = 0;
+
+    // A block that would wrap around the end of a ring that isn't mirrored
+    // gets rendered here first
+    std::vector<float> scratch_;
+    size_t max_render_size_ = 0;
+
+    std::atomic<uint32_t> read_ahead_ = BUFFERED_RENDERER_READ_AHEAD;
+
+    // Automatic tuning, only touched by the render thread
+    AutoTune tune_;
+    double tune_busy_ = 0.0;
+    double tune_span_ = 0.0;
+    uint64_t tune_underruns_ = 0;
+    uint32_t tune_calm_ = 0;
+
+    void tune();
+
+    // Only touched by the thread that calls read()
+    alignas(EVBUF_CACHELINE) std::atomic<uint64_t> reads_ = 0;
+    std::atomic<uint64_t> underruns_ = 0;
+    std::atomic<uint64_t> late_samples_ = 0;
+    bool primed_ = false;
+    bool faded_out_ = false;
+
+    void fade(float *buffer, size_t frames, bool in);
+
     std::shared_ptr<std::atomic<bool>> killed_;
     std::thread render_thread_;
     AudioStreamParams stream_params_;
     AudioPipe audio_pipe_;
+    ThreadInit thread_init_;
 
   public:
+    // thread_init runs on the render thread before its first iteration,
+    // it's where the owner can set its scheduling up.
+    // The sample ring is allocated once, for the biggest render size
+    // between initial_render_size and tune.max_size, set_render_size()
+    // can't go past it
     BufferedRenderer(AudioPipe render_function, AudioStreamParams params,
-                     size_t initial_render_size);
+                     size_t initial_render_size,
+                     ThreadInit thread_init = nullptr,
+                     AutoTune tune = {0, 0, 50});
 
     ~BufferedRenderer();
 
@@ -72,7 +153,16 @@ class BufferedRenderer {
     BufferedRenderer(BufferedRenderer &&) = delete;
     BufferedRenderer &operator=(BufferedRenderer &&) = delete;
 
-    void read(std::vector<float> &dest);
+    // Never waits for the render thread. Whatever it didn't deliver in time
+    // is played as silence, and counted as an underrun
+    void read(float *dest, size_t count);
+
+    // Zero copy reads, for consumers that can work on the ring in place.
+    // acquire() returns up to max samples that are ready, without waiting,
+    // and release() hands them back to the render thread once done
+    std::span<const float> acquire(size_t max);
+    void release(size_t count);
+
     void set_render_size(size_t size);
 
     // The number of samples currently buffered.
@@ -87,11 +177,22 @@ class BufferedRenderer {
     // The number of samples to render each iteration.
     size_t render_size() const;
 
+    // How far ahead the render thread stays, in percent of the last read.
+    uint32_t read_ahead() const;
+
     // The average load of the renderer (0.0 to 1.0).
     double average_renderer_load() const;
 
     // The most recent renderer load (0.0 to 1.0).
     double last_renderer_load() const;
+
+    // The number of reads that came up short, and the samples they were
+    // short of. Reads before the first block was ready don't count.
+    uint64_t underruns() const;
+    uint64_t late_samples() const;
+
+    // Everything above, for the stats API
+    void get_metrics(AudioMetrics &m) const;
 };
 
 #endif // BUFFERED_RENDERER_H
\ No newline at end of file
@@ -18,125 +18,199 @@
  */
 
 #include "Limiter.hpp"
-#include <exception>
-#include <math.h>
+#include "../Common.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <stdexcept>
-#include <stdio.h>
-#include <stdlib.h>
-
-// Helper function to calculate smoothing coefficients from time in ms.
-static float calculate_coeff(float time_ms, float sample_rate) {
-    if (time_ms <= 0.0f)
-        return 1.0f;
-    return expf(-1.0f / (time_ms * 0.001f * sample_rate));
+
+#if defined(_M_IX86) || defined(_M_AMD64) || defined(_M_X64)
+#define LIMITER_SSE2
+#include <emmintrin.h>
+#elif defined(_M_ARM64)
+#define LIMITER_NEON
+#include <arm_neon.h>
+#endif
+
+static uint32_t PowerOfTwo(uint32_t min) {
+    uint32_t size = 1;
+    while (size < min)
+        size <<= 1;
+    return size;
 }
 
-OmniMIDI::Compressor::Compressor(float sample_rate, float threshold,
-                                 float ratio, float attack_ms, float release_ms,
-                                 float lookahead_ms) {
-    if (sample_rate <= 0) {
-        throw std::runtime_error("Invalid sample rate");
+// Scales frames [from, frames) of src by their gain into dst one sample at a
+// time, the vector kernels use it for whatever doesn't fill a whole register
+static void ApplyGainsTail(float *dst, const float *src, const float *gains,
+                           uint16_t channels, size_t from, size_t frames) {
+    for (size_t i = from; i < frames; i++) {
+        for (uint16_t c = 0; c < channels; c++)
+            dst[i * channels + c] = src[i * channels + c] * gains[i];
     }
+}
 
-    // --- Set user parameters ---
-    this->threshold = threshold;
-    this->ratio = ratio;
-    this->attack_ms = attack_ms;
-    this->release_ms = release_ms;
-    this->lookahead_ms = lookahead_ms;
-
-    // --- Calculate internal parameters ---
-    this->attack_coeff = calculate_coeff(attack_ms, sample_rate);
-    this->release_coeff = calculate_coeff(release_ms, sample_rate);
-    this->envelope = 0.0f;
-    this->gain = 1.0f;
-
-    // --- Initialize lookahead buffer ---
-    this->buffer_size = (size_t)(lookahead_ms * 0.001f * sample_rate);
-    if (this->buffer_size < 1) {
-        this->buffer_size = 1;
+// The vector kernels handle stereo, four frames at a time: the four gains
+// are duplicated pairwise so each one covers both samples of its frame
+static void ApplyGains(float *dst, const float *src, const float *gains,
+                       uint16_t channels, size_t frames) {
+    size_t i = 0;
+
+#if defined(LIMITER_SSE2)
+    if (channels == 2) {
+        for (; i + 4 <= frames; i += 4) {
+            const __m128 g = _mm_loadu_ps(gains + i);
+            const float *in = src + i * 2;
+            float *out = dst + i * 2;
+
+            _mm_storeu_ps(out, _mm_mul_ps(_mm_loadu_ps(in),
+                                          _mm_unpacklo_ps(g, g)));
+            _mm_storeu_ps(out + 4, _mm_mul_ps(_mm_loadu_ps(in + 4),
+                                              _mm_unpackhi_ps(g, g)));
+        }
     }
-
-    this->delay_buffer = (float *)malloc(this->buffer_size * sizeof(float));
-    if (!this->delay_buffer) {
-        throw std::runtime_error("Failed to allocate memory for delay buffer");
+#elif defined(LIMITER_NEON)
+    if (channels == 2) {
+        for (; i + 4 <= frames; i += 4) {
+            const float32x4_t g = vld1q_f32(gains + i);
+            const float32x4x2_t pairs = vzipq_f32(g, g);
+            const float *in = src + i * 2;
+            float *out = dst + i * 2;
+
+            vst1q_f32(out, vmulq_f32(vld1q_f32(in), pairs.val[0]));
+            vst1q_f32(out + 4, vmulq_f32(vld1q_f32(in + 4), pairs.val[1]));
+        }
     }
+#endif
 
-    this->write_index = 0;
-    this->read_index = 1;
+    ApplyGainsTail(dst, src, gains, channels, i, frames);
 }
 
-OmniMIDI::Compressor::~Compressor() {
-    if (this->delay_buffer) {
-        free(this->delay_buffer);
-    }
+OmniMIDI::AudioLimiter::AudioLimiter(uint16_t channels, uint32_t sample_rate)
+    : num_channels(channels) {
+    if (!channels || !sample_rate)
+        throw std::runtime_error("Error initializing audio limiter");
+
+    lookahead = (uint32_t)std::lround(LIMITER_LOOKAHEAD_MS * 0.001f *
+                                      (float)sample_rate);
+    if (lookahead < 1)
+        lookahead = 1;
+
+    release_coeff =
+        expf(-1.0f / (LIMITER_RELEASE_MS * 0.001f * (float)sample_rate));
+
+    const uint32_t delay_frames = PowerOfTwo(lookahead + LIMITER_BLOCK);
+    delay_mask = delay_frames - 1;
+    delay = std::make_unique<float[]>((size_t)delay_frames * channels);
+
+    const uint32_t window = PowerOfTwo(lookahead + 1);
+    window_mask = window - 1;
+    peaks = std::make_unique<Peak[]>(window);
+
+    // Unity gain before the first peak comes in
+    targets = std::make_unique<float[]>(window);
+    for (uint32_t i = 0; i < window; i++)
+        targets[i] = 1.0f;
+    targets_sum = lookahead + 1;
+    window_scale = 1.0 / (lookahead + 1);
 }
 
-float OmniMIDI::Compressor::process(float input) {
-    float output;
-
-    // --- Lookahead Delay Line ---
-    delay_buffer[write_index] = input;
-    float delayed_input = delay_buffer[read_index];
-    float lookahead_sample = input;
-
-    // --- Envelope Detection ---
-    float rectified_sample = fabsf(lookahead_sample);
-    if (rectified_sample > envelope) {
-        envelope =
-            attack_coeff * envelope + (1.0f - attack_coeff) * rectified_sample;
-    } else {
-        envelope = release_coeff * envelope +
-                   (1.0f - release_coeff) * rectified_sample;
+// Fills block_gains with the gains of the frames leaving the delay line as
+// frames frames of samples enter it. A frame stays the maximum of the window
+// for the lookahead + 1 frames it spends in the delay line, so the target
+// gains averaged over that window are all at or below its own by the time
+// it's played. The state is kept in locals for the block, the compiler
+// can't tell the rings don't alias the members.
+void OmniMIDI::AudioLimiter::Gains(const float *samples, size_t frames) {
+    const uint16_t channels = num_channels;
+    const uint32_t mask = window_mask;
+    Peak *const window = peaks.get();
+    float *const ramp_targets = targets.get();
+
+    uint32_t head = peaks_head, tail = peaks_tail;
+    uint64_t frame = pos;
+    double sum = targets_sum;
+    float g = gain;
+
+    for (size_t i = 0; i < frames; i++, frame++) {
+        const float *in = samples + i * channels;
+        float peak = 0.0f;
+        for (uint16_t c = 0; c < channels; c++)
+            peak = std::max(peak, fabsf(in[c]));
+
+        // Frames come in one at a time, so at most one expires per frame
+        if (head != tail && window[head & mask].frame + lookahead < frame)
+            head++;
+
+        while (head != tail && window[(tail - 1) & mask].value <= peak)
+            tail--;
+
+        window[tail++ & mask] = {frame, peak};
+
+        const float max = window[head & mask].value;
+        const float target =
+            max > LIMITER_THRESHOLD ? LIMITER_THRESHOLD / max : 1.0f;
+
+        sum += target - ramp_targets[(frame - lookahead - 1) & mask];
+        ramp_targets[frame & mask] = target;
+
+        const float ramp = (float)(sum * window_scale);
+        if (ramp < g)
+            g = ramp;
+        else
+            g = ramp + (g - ramp) * release_coeff;
+
+        block_gains[i] = g;
     }
 
-    // --- Gain Computation ---
-    // Calculate the desired gain reduction based on the smoothed envelope.
-    float target_gain = 1.0f;
-    if (envelope > threshold) {
-        target_gain = (threshold + (envelope - threshold) / ratio) / envelope;
-    }
+    peaks_head = head;
+    peaks_tail = tail;
+    pos = frame;
+    targets_sum = sum;
+    gain = g;
+}
 
-    // --- Gain Application ---
-    if (target_gain < gain) {
-        gain = target_gain; // Instant attack
-    } else {
-        // Smooth release
-        gain = release_coeff * gain + (1.0f - release_coeff) * target_gain;
-    }
+// Copies frames frames of samples in the delay line, starting at frame
+void OmniMIDI::AudioLimiter::Store(const float *samples, uint64_t frame,
+                                   size_t frames) {
+    const size_t at = frame & delay_mask;
+    const size_t first = std::min(frames, (size_t)delay_mask + 1 - at);
 
-    // --- Apply Gain ---
-    output = delayed_input * gain;
+    memcpy(&delay[at * num_channels], samples,
+           first * num_channels * sizeof(float));
+    memcpy(&delay[0], samples + first * num_channels,
+           (frames - first) * num_channels * sizeof(float));
+}
 
-    // --- Update Buffer Indices ---
-    write_index = (write_index + 1) % buffer_size;
-    read_index = (read_index + 1) % buffer_size;
+void OmniMIDI::AudioLimiter::process(float *samples, size_t frames) {
+    while (frames) {
+        const size_t block = std::min(frames, (size_t)LIMITER_BLOCK);
+        const uint64_t start = pos;
 
-    return output;
-}
+        Gains(samples, block);
 
-OmniMIDI::AudioLimiter::AudioLimiter(uint16_t channels, uint32_t sample_rate) {
-    num_channels = channels;
-    for (uint16_t i = 0; i < channels; i++) {
-        try {
-            Compressor *c =
-                new Compressor(sample_rate, 0.3, 1000.0, 10.0, 50.0, 10.0);
-            compressors.push_back(c);
-        } catch (std::exception &e) {
-            throw std::runtime_error("Error initializing audio limiter");
-        }
-    }
-}
+        // The delay line has room for the whole block past the lookahead,
+        // so storing it first never overwrites a frame still to be played
+        Store(samples, start, block);
 
-OmniMIDI::AudioLimiter::~AudioLimiter() {
-    for (auto c : compressors) {
-        delete c;
+        const size_t at = (start - lookahead) & delay_mask;
+        const size_t first = std::min(block, (size_t)delay_mask + 1 - at);
+
+        ApplyGains(samples, &delay[at * num_channels], block_gains,
+                   num_channels, first);
+        ApplyGains(samples + first * num_channels, &delay[0],
+                   block_gains + first, num_channels, block - first);
+
+        samples += block * num_channels;
+        frames -= block;
     }
-    compressors.clear();
 }
 
-void OmniMIDI::AudioLimiter::process(std::vector<float> &samples) {
-    for (size_t i = 0; i < samples.size(); i++) {
-        samples[i] = compressors[i % num_channels]->process(samples[i]);
-    }
-}
\ No newline at end of file
+const char *OmniMIDI::AudioLimiter::KernelName() {
+#if defined(LIMITER_SSE2)
+    return "SSE2";
+#elif defined(LIMITER_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
@@ -20,48 +20,80 @@
 #ifndef LIMITER_H
 #define LIMITER_H
 
+#include <cstddef>
 #include <cstdint>
-#include <stddef.h>
-#include <vector>
+#include <memory>
 
-namespace OmniMIDI {
+// Level the output is held under, in linear amplitude
+#define LIMITER_THRESHOLD 0.3f
 
-class Compressor {
-  public:
-    Compressor(float sample_rate, float threshold, float ratio, float attack_ms,
-               float release_ms, float lookahead_ms);
-    ~Compressor();
-    float process(float input);
+// How far ahead the limiter looks for peaks, which is also the latency it
+// adds and the length of the attack ramp
+#define LIMITER_LOOKAHEAD_MS 5.0f
 
-  private:
-    float threshold;    // Threshold in linear amplitude
-    float ratio;        // Compression ratio (e.g., 4.0 for 4:1)
-    float attack_ms;    // Attack time in milliseconds
-    float release_ms;   // Release time in milliseconds
-    float lookahead_ms; // Lookahead time in milliseconds
+// Time constant of the gain recovering after a peak
+#define LIMITER_RELEASE_MS 50.0f
 
-    float attack_coeff;
-    float release_coeff;
-    float envelope;
-    float gain;
+// Frames per block, the gains of a block are worked out first and then
+// applied to the whole block at once
+#define LIMITER_BLOCK 256
 
-    float *delay_buffer;
-    size_t buffer_size;
-    size_t write_index;
-    size_t read_index;
-};
+namespace OmniMIDI {
 
+// Stereo linked lookahead limiter: every channel of a frame gets the same
+// gain, worked out from the loudest sample of the frames still in the delay
+// line, so a peak is already fully attenuated when it leaves it
 class AudioLimiter {
   private:
-    std::vector<Compressor *> compressors;
     uint16_t num_channels;
+    uint32_t lookahead;
+    float release_coeff;
+
+    // Interleaved delay line, delay_mask + 1 frames, room for the lookahead
+    // plus a whole block so a block can be written before it's read back
+    std::unique_ptr<float[]> delay;
+    uint32_t delay_mask;
+
+    // Sliding window maximum of the frame peaks over the last lookahead + 1
+    // frames, a monotonic deque kept in a ring of window_mask + 1 entries
+    struct Peak {
+        uint64_t frame;
+        float value;
+    };
+    std::unique_ptr<Peak[]> peaks;
+    uint32_t peaks_head = 0;
+    uint32_t peaks_tail = 0;
+
+    // Target gains of the same window, averaged into a linear attack ramp
+    // that reaches the target as the peak reaches the output
+    std::unique_ptr<float[]> targets;
+    double targets_sum;
+    double window_scale;
+    uint32_t window_mask;
+
+    float gain = 1.0f;
+    uint64_t pos = 0;
+    float block_gains[LIMITER_BLOCK];
+
+    void Gains(const float *samples, size_t frames);
+    void Store(const float *samples, uint64_t frame, size_t frames);
 
   public:
     AudioLimiter(uint16_t channels, uint32_t sample_rate);
-    ~AudioLimiter();
-    void process(std::vector<float> &samples);
+    AudioLimiter(const AudioLimiter &) = delete;
+    AudioLimiter &operator=(const AudioLimiter &) = delete;
+
+    // In place, on frames frames of interleaved samples, the output is
+    // lookahead frames late
+    void process(float *samples, size_t frames);
+
+    // Frames of latency the limiter adds
+    uint32_t Latency() const { return lookahead; }
+
+    // Name of the kernel process() applies the gains with on this CPU
+    static const char *KernelName();
 };
 
 } // namespace OmniMIDI
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,233 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+#include "Mixdown.hpp"
+#include "../Common.hpp"
+#include <cstring>
+#include <new>
+
+#if defined(_M_IX86) || defined(_M_AMD64) || defined(_M_X64)
+#define MIXDOWN_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MIXDOWN_TARGET_AVX
+#else
+#define MIXDOWN_TARGET_AVX __attribute__((target("avx")))
+#endif
+#elif defined(_M_ARM64)
+#define MIXDOWN_NEON
+#include <arm_neon.h>
+#endif
+
+typedef void (*SumFunc)(float *dst, const float *const *srcs,
+                        uint32_t num_srcs, size_t offset, size_t count);
+
+struct SumKernel {
+    SumFunc func;
+    const char *name;
+};
+
+// Sums samples [offset + from, offset + count) one by one, the vector
+// kernels use it for whatever doesn't fill a whole register
+static void SumTail(float *dst, const float *const *srcs, uint32_t num_srcs,
+                    size_t offset, size_t from, size_t count) {
+    for (size_t i = offset + from; i < offset + count; i++) {
+        float sum = 0.0f;
+        for (uint32_t s = 0; s < num_srcs; s++)
+            sum += srcs[s][i];
+        dst[i] = sum;
+    }
+}
+
+// The vector kernels take the sources four at a time, adding them pairwise
+// before touching dst, so dst is only loaded and stored once per four
+// sources. The first pass overwrites dst instead of adding to it.
+
+#if defined(MIXDOWN_X86)
+static void SumSSE2(float *dst, const float *const *srcs, uint32_t num_srcs,
+                    size_t offset, size_t count) {
+    const size_t vec = count & ~(size_t)3;
+    float *out = dst + offset;
+    uint32_t s = 0;
+
+    for (; s + 4 <= num_srcs; s += 4) {
+        const float *a = srcs[s] + offset, *b = srcs[s + 1] + offset;
+        const float *c = srcs[s + 2] + offset, *d = srcs[s + 3] + offset;
+
+        for (size_t i = 0; i < vec; i += 4) {
+            __m128 sum = _mm_add_ps(
+                _mm_add_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)),
+                _mm_add_ps(_mm_loadu_ps(c + i), _mm_loadu_ps(d + i)));
+            if (s)
+                sum = _mm_add_ps(sum, _mm_loadu_ps(out + i));
+            _mm_storeu_ps(out + i, sum);
+        }
+    }
+
+    for (; s < num_srcs; s++) {
+        const float *a = srcs[s] + offset;
+
+        for (size_t i = 0; i < vec; i += 4) {
+            __m128 sum = _mm_loadu_ps(a + i);
+            if (s)
+                sum = _mm_add_ps(sum, _mm_loadu_ps(out + i));
+            _mm_storeu_ps(out + i, sum);
+        }
+    }
+
+    SumTail(dst, srcs, num_srcs, offset, vec, count);
+}
+
+MIXDOWN_TARGET_AVX
+static void SumAVX(float *dst, const float *const *srcs, uint32_t num_srcs,
+                   size_t offset, size_t count) {
+    const size_t vec = count & ~(size_t)7;
+    float *out = dst + offset;
+    uint32_t s = 0;
+
+    for (; s + 4 <= num_srcs; s += 4) {
+        const float *a = srcs[s] + offset, *b = srcs[s + 1] + offset;
+        const float *c = srcs[s + 2] + offset, *d = srcs[s + 3] + offset;
+
+        for (size_t i = 0; i < vec; i += 8) {
+            __m256 sum = _mm256_add_ps(
+                _mm256_add_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)),
+                _mm256_add_ps(_mm256_loadu_ps(c + i), _mm256_loadu_ps(d + i)));
+            if (s)
+                sum = _mm256_add_ps(sum, _mm256_loadu_ps(out + i));
+            _mm256_storeu_ps(out + i, sum);
+        }
+    }
+
+    for (; s < num_srcs; s++) {
+        const float *a = srcs[s] + offset;
+
+        for (size_t i = 0; i < vec; i += 8) {
+            __m256 sum = _mm256_loadu_ps(a + i);
+            if (s)
+                sum = _mm256_add_ps(sum, _mm256_loadu_ps(out + i));
+            _mm256_storeu_ps(out + i, sum);
+        }
+    }
+
+    SumTail(dst, srcs, num_srcs, offset, vec, count);
+}
+
+// AVX needs both the CPU and the OS, which has to save the YMM registers
+static bool HasAVX() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+
+    const bool osxsave = info[2] & (1 << 27);
+    const bool avx = info[2] & (1 << 28);
+
+    return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+#endif
+}
+#elif defined(MIXDOWN_NEON)
+static void SumNEON(float *dst, const float *const *srcs, uint32_t num_srcs,
+                    size_t offset, size_t count) {
+    const size_t vec = count & ~(size_t)3;
+    float *out = dst + offset;
+    uint32_t s = 0;
+
+    for (; s + 4 <= num_srcs; s += 4) {
+        const float *a = srcs[s] + offset, *b = srcs[s + 1] + offset;
+        const float *c = srcs[s + 2] + offset, *d = srcs[s + 3] + offset;
+
+        for (size_t i = 0; i < vec; i += 4) {
+            float32x4_t sum =
+                vaddq_f32(vaddq_f32(vld1q_f32(a + i), vld1q_f32(b + i)),
+                          vaddq_f32(vld1q_f32(c + i), vld1q_f32(d + i)));
+            if (s)
+                sum = vaddq_f32(sum, vld1q_f32(out + i));
+            vst1q_f32(out + i, sum);
+        }
+    }
+
+    for (; s < num_srcs; s++) {
+        const float *a = srcs[s] + offset;
+
+        for (size_t i = 0; i < vec; i += 4) {
+            float32x4_t sum = vld1q_f32(a + i);
+            if (s)
+                sum = vaddq_f32(sum, vld1q_f32(out + i));
+            vst1q_f32(out + i, sum);
+        }
+    }
+
+    SumTail(dst, srcs, num_srcs, offset, vec, count);
+}
+#else
+static void SumScalar(float *dst, const float *const *srcs, uint32_t num_srcs,
+                      size_t offset, size_t count) {
+    SumTail(dst, srcs, num_srcs, offset, 0, count);
+}
+#endif
+
+static SumKernel SelectKernel() {
+#if defined(MIXDOWN_X86)
+    if (HasAVX())
+        return {SumAVX, "AVX"};
+
+    return {SumSSE2, "SSE2"};
+#elif defined(MIXDOWN_NEON)
+    return {SumNEON, "NEON"};
+#else
+    return {SumScalar, "scalar"};
+#endif
+}
+
+static const SumKernel &Kernel() {
+    static const SumKernel kernel = SelectKernel();
+    return kernel;
+}
+
+void OmniMIDI::Mixdown::Sum(float *dst, const float *const *srcs,
+                            uint32_t num_srcs, size_t offset, size_t count) {
+    if (!num_srcs) {
+        memset(dst + offset, 0, count * sizeof(float));
+        return;
+    }
+
+    Kernel().func(dst, srcs, num_srcs, offset, count);
+}
+
+const char *OmniMIDI::Mixdown::KernelName() { return Kernel().name; }
+
+size_t OmniMIDI::Mixdown::Stride(size_t len) {
+    constexpr size_t per_line = MIXDOWN_ALIGN / sizeof(float);
+    return (len + per_line - 1) & ~(per_line - 1);
+}
+
+float *OmniMIDI::Mixdown::AllocArena(size_t floats) {
+    float *arena = static_cast<float *>(::operator new(
+        floats * sizeof(float), std::align_val_t(MIXDOWN_ALIGN)));
+    memset(arena, 0, floats * sizeof(float));
+    return arena;
+}
+
+void OmniMIDI::Mixdown::FreeArena(float *arena) {
+    ::operator delete(arena, std::align_val_t(MIXDOWN_ALIGN));
+}
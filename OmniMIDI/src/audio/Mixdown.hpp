@@ -0,0 +1,57 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+#ifndef MIXDOWN_H
+#define MIXDOWN_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Alignment of the mixdown buffers, one cache line, which is also enough for
+// the widest vector loads
+#define MIXDOWN_ALIGN 64
+
+// Floats per chunk when a mixdown is split across threads, a multiple of
+// MIXDOWN_ALIGN so every chunk of an arena buffer stays aligned
+#define MIXDOWN_CHUNK 256
+
+namespace OmniMIDI {
+
+class Mixdown {
+  public:
+    // Writes the sum of floats [offset, offset + count) of every source to
+    // the same range of dst, dst can't be one of the sources
+    static void Sum(float *dst, const float *const *srcs, uint32_t num_srcs,
+                    size_t offset, size_t count);
+
+    // Name of the kernel Sum() picked for this CPU
+    static const char *KernelName();
+
+    // Floats between two buffers of len floats in an arena
+    static size_t Stride(size_t len);
+
+    // Zeroed, MIXDOWN_ALIGN aligned block of floats, has to be freed with
+    // FreeArena()
+    static float *AllocArena(size_t floats);
+    static void FreeArena(float *arena);
+};
+
+} // namespace OmniMIDI
+
+#endif
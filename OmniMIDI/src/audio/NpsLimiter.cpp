@@ -16,113 +16,103 @@
  * You should have received a copy of the MIT License along with this
  * program.  If not, see <https://opensource.org/license/mit/>.
  */
-
 #include "NpsLimiter.hpp"
-#include <atomic>
-#include <chrono>
+#include "../Utils.hpp"
+#include <algorithm>
 #include <cstring>
 
 OmniMIDI::NpsLimiter::NpsLimiter(uint32_t channels, uint64_t max_nps) {
-    rough_time_ = std::make_shared<std::atomic<uint64_t>>(0);
-    stop_flag_ = std::make_shared<std::atomic<bool>>(false);
-    timer_thread_ = std::thread(&NpsLimiter::timer_loop, this);
     max_nps_ = max_nps;
+    num_channels_ = channels;
+    channels_ = std::make_unique<ChannelNpsLimiter[]>(channels);
 
+    const uint64_t time = OMShared::Funcs::MonotonicMs() / NPS_WINDOW_MS;
     for (uint32_t i = 0; i < channels; i++) {
-        channels_.push_back(ChannelNpsLimiter(rough_time_));
+        channels_[i].last_time_ = time;
     }
 }
 
-OmniMIDI::NpsLimiter::~NpsLimiter() {
-    stop_flag_->store(true);
-    if (timer_thread_.joinable()) {
-        timer_thread_.join();
-    }
-    channels_.clear();
-}
+// Moves the ring forward to the current window. The window being left
+// joins the total, and the ones that fell out of the last second get
+// cleared and taken out of it.
+void OmniMIDI::NpsLimiter::ChannelNpsLimiter::check_time(uint64_t time) {
+    if (time <= last_time_)
+        return;
 
-void OmniMIDI::NpsLimiter::timer_loop() {
-    uint64_t current_time = 0;
-    auto last_tick = std::chrono::steady_clock::now();
-    while (!stop_flag_->load()) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(NPS_WINDOW_MS));
-        auto now = std::chrono::steady_clock::now();
-        auto diff = std::chrono::duration_cast<std::chrono::milliseconds>(
-            now - last_tick);
-        current_time += diff.count();
-        rough_time_->store(current_time);
-        last_tick = now;
-    }
-}
+    total_window_sum_ += windows_[last_time_ % NPS_WINDOWS];
 
-void OmniMIDI::NpsLimiter::ChannelNpsLimiter::check_time() {
-    uint64_t time = rough_time_->load();
-    if (time > last_time_) {
-        windows_.push_back({last_time_, current_window_sum_});
-        total_window_sum_ += current_window_sum_;
-        current_window_sum_ = 0;
-        last_time_ = time;
+    if (time - last_time_ >= NPS_WINDOWS) {
+        memset(windows_, 0, sizeof(windows_));
+        total_window_sum_ = 0;
+    } else {
+        for (uint64_t t = last_time_ + 1; t <= time; t++) {
+            uint32_t &window = windows_[t % NPS_WINDOWS];
+            total_window_sum_ -= window;
+            window = 0;
+        }
     }
-}
 
-uint64_t OmniMIDI::NpsLimiter::ChannelNpsLimiter::calculate_nps() {
-    check_time();
+    last_time_ = time;
+}
 
-    while (!windows_.empty()) {
-        uint64_t cutoff = (last_time_ > 1000) ? last_time_ - 1000 : 0;
-        if (windows_.front().time < cutoff) {
-            total_window_sum_ -= windows_.front().notes;
-            windows_.pop_front();
-        } else {
-            break;
-        }
-    }
+uint64_t OmniMIDI::NpsLimiter::ChannelNpsLimiter::calculate_nps(uint64_t time) {
+    check_time(time);
 
-    uint64_t short_nps = current_window_sum_ * (1000 / NPS_WINDOW_MS) * 4 / 3;
+    uint64_t current_window_sum = windows_[last_time_ % NPS_WINDOWS];
+    uint64_t short_nps = current_window_sum * NPS_WINDOWS * 4 / 3;
     uint64_t long_nps = total_window_sum_;
 
     return std::max(short_nps, long_nps);
 }
 
 void OmniMIDI::NpsLimiter::ChannelNpsLimiter::add_note() {
-    current_window_sum_++;
+    windows_[last_time_ % NPS_WINDOWS]++;
 }
 
 bool OmniMIDI::NpsLimiter::note_on(uint32_t channel, uint8_t key, uint8_t vel) {
     if (key > 127)
         return false;
 
+    const uint64_t time = OMShared::Funcs::MonotonicMs() / NPS_WINDOW_MS;
     ChannelNpsLimiter *ch = &channels_[channel];
-    uint64_t curr_nps = ch->calculate_nps();
 
-    if (NpsLimiter::should_send_for_vel_and_nps(vel, curr_nps, max_nps_)) {
-        ch->add_note();
-        return true;
-    } else {
-        ch->missed_notes_[key]++;
-        return false;
+    {
+        ChannelLock lock(ch->lock_);
+        uint64_t curr_nps = ch->calculate_nps(time);
+
+        if (NpsLimiter::should_send_for_vel_and_nps(vel, curr_nps, max_nps_)) {
+            ch->add_note();
+            return true;
+        }
     }
+
+    ch->missed_notes_[key].fetch_add(1, std::memory_order_relaxed);
+    return false;
 }
 
 void OmniMIDI::NpsLimiter::ChannelNpsLimiter::reset() {
-    memset(&missed_notes_, 0, sizeof(missed_notes_));
+    for (auto &missed : missed_notes_)
+        missed.store(0, std::memory_order_relaxed);
 }
 
 bool OmniMIDI::NpsLimiter::note_off(uint32_t channel, uint8_t key) {
     if (key > 127)
         return false;
 
-    ChannelNpsLimiter *ch = &channels_[channel];
-    if (ch->missed_notes_[key] > 0) {
-        ch->missed_notes_[key]--;
-        return false;
-    } else {
-        return true;
+    // Swallow the note off of a note on that got dropped
+    std::atomic<uint32_t> &missed = channels_[channel].missed_notes_[key];
+    uint32_t count = missed.load(std::memory_order_relaxed);
+    while (count > 0) {
+        if (missed.compare_exchange_weak(count, count - 1,
+                                         std::memory_order_relaxed))
+            return false;
     }
+
+    return true;
 }
 
 void OmniMIDI::NpsLimiter::reset() {
-    for (auto it = channels_.begin(); it != channels_.end(); ++it) {
-        it->reset();
+    for (uint32_t i = 0; i < num_channels_; i++) {
+        channels_[i].reset();
     }
-}
\ No newline at end of file
+}
@@ -24,58 +24,64 @@
 // https://github.com/BlackMIDIDevs/xsynth/blob/master/realtime/src/event_senders.rs
 // Written by arduano
 
-#include <deque>
+#include "../Common.hpp"
+#include <atomic>
+#include <cstdint>
 #include <memory>
-#include <thread>
-#include <vector>
 
 #define NPS_WINDOW_MS 1
 
+// One second worth of NPS_WINDOW_MS windows
+#define NPS_WINDOWS (1000 / NPS_WINDOW_MS)
+
 namespace OmniMIDI {
 
 class NpsLimiter {
   private:
-    struct NpsWindow {
-        uint64_t time;
-        uint64_t notes;
-    };
-
-    struct ChannelNpsLimiter {
-        std::shared_ptr<std::atomic<uint64_t>> rough_time_;
+    // Note counts of the last second, one bucket per window in a ring
+    // indexed by time, so nothing gets allocated as time goes by.
+    // The ring is guarded by a per-channel lock, as note_on() can be called
+    // from more than one thread. The missed notes are plain atomics, so
+    // note_off() never has to take it.
+    struct alignas(64) ChannelNpsLimiter {
+        std::atomic_flag lock_ = ATOMIC_FLAG_INIT;
         uint64_t last_time_ = 0;
-        std::deque<NpsWindow> windows_;
         uint64_t total_window_sum_ = 0;
-        uint64_t current_window_sum_ = 0;
+        uint32_t windows_[NPS_WINDOWS] = {0};
 
-        uint64_t missed_notes_[128] = {0};
+        std::atomic<uint32_t> missed_notes_[128] = {};
 
-        ChannelNpsLimiter(std::shared_ptr<std::atomic<uint64_t>> rough_time)
-            : rough_time_(rough_time) {}
-        uint64_t calculate_nps();
+        uint64_t calculate_nps(uint64_t time);
         void add_note();
-        void check_time();
+        void check_time(uint64_t time);
         void reset();
     };
 
-    void timer_loop();
+    // Only ever held while updating a ring, so spinning is cheaper than
+    // going to sleep
+    struct ChannelLock {
+        std::atomic_flag &flag;
+
+        ChannelLock(std::atomic_flag &f) : flag(f) {
+            while (flag.test_and_set(std::memory_order_acquire))
+                CPU_PAUSE();
+        }
+        ~ChannelLock() { flag.clear(std::memory_order_release); }
+    };
 
     static inline bool should_send_for_vel_and_nps(uint8_t vel, uint64_t nps,
                                                    uint64_t max_nps) {
         return static_cast<uint64_t>(vel) * max_nps / 127 > nps;
     }
 
-    std::shared_ptr<std::atomic<uint64_t>> rough_time_;
-    std::shared_ptr<std::atomic<bool>> stop_flag_;
-    std::thread timer_thread_;
     uint64_t max_nps_;
 
-    std::vector<ChannelNpsLimiter> channels_;
+    uint32_t num_channels_;
+    std::unique_ptr<ChannelNpsLimiter[]> channels_;
 
   public:
     NpsLimiter(uint32_t channels, uint64_t max_nps);
-    ~NpsLimiter();
 
-    // Disable copy/move to prevent issues with thread ownership.
     NpsLimiter(const NpsLimiter &) = delete;
     NpsLimiter &operator=(const NpsLimiter &) = delete;
     NpsLimiter(NpsLimiter &&) = delete;
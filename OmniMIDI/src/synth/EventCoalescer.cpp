@@ -0,0 +1,99 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+#include "EventCoalescer.hpp"
+#include <cstring>
+
+size_t OmniMIDI::EventCoalescer::Process(std::span<ShortEvent> evs) {
+    size_t cc = 0, pitchBend = 0, pressure = 0;
+
+    memset(channels, 0, sizeof(channels));
+
+    // Walk the batch backwards, the last value of each control wins
+    for (size_t i = evs.size(); i-- > 0;) {
+        const ShortEvent ev = evs[i];
+        ChannelState &chan = channels[ev & 0xF];
+
+        switch (ev & 0xF0) {
+        case 0xB0: {
+            const uint8_t ctrl = (ev >> 8) & 0x7F;
+
+            if (!IsCoalescableCC(ctrl))
+                break;
+
+            const uint64_t bit = 1ULL << (ctrl & 63);
+            if (chan.cc[ctrl >> 6] & bit) {
+                evs[i] = 0;
+                cc++;
+            } else
+                chan.cc[ctrl >> 6] |= bit;
+
+            break;
+        }
+
+        case 0xE0:
+            if (chan.pitchBend) {
+                evs[i] = 0;
+                pitchBend++;
+            } else
+                chan.pitchBend = true;
+
+            break;
+
+        case 0xD0:
+            if (chan.pressure) {
+                evs[i] = 0;
+                pressure++;
+            } else
+                chan.pressure = true;
+
+            break;
+
+        // Notes and program changes need the values that were current when
+        // they were sent, so nothing before them can be dropped
+        case 0x80:
+        case 0x90:
+        case 0xC0:
+            chan = {};
+            break;
+
+        // Realtime messages (clock, active sensing...) don't change anything
+        case 0xF0:
+            if ((ev & 0xFF) < 0xF8 || (ev & 0xFF) == 0xFF)
+                memset(channels, 0, sizeof(channels));
+
+            break;
+
+        // Poly aftertouch, and the events that were already emptied
+        default:
+            break;
+        }
+    }
+
+    if (cc)
+        stats.ControlChanges.fetch_add(cc, std::memory_order_relaxed);
+
+    if (pitchBend)
+        stats.PitchBends.fetch_add(pitchBend, std::memory_order_relaxed);
+
+    if (pressure)
+        stats.ChannelPressure.fetch_add(pressure, std::memory_order_relaxed);
+
+    return cc + pitchBend + pressure;
+}
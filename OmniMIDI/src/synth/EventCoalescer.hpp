@@ -0,0 +1,88 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+#ifndef _EVCOALESCER_H
+#define _EVCOALESCER_H
+
+#pragma once
+
+#include "../EvBuf_t.hpp"
+#include <atomic>
+#include <cstdint>
+#include <span>
+
+namespace OmniMIDI {
+// Drops controller, pitch bend and channel pressure updates that get
+// superseded by a later one on the same channel within the same batch of
+// events, so that the synth only sees the last value.
+// Anything that depends on the current value stops the coalescing for its
+// channel: note-ons/offs and program changes reset it for that channel,
+// system messages for all of them. Bank select, data entry, RPN/NRPN and
+// channel mode messages are never touched.
+class EventCoalescer {
+  public:
+    struct Stats {
+        std::atomic<size_t> ControlChanges = 0;
+        std::atomic<size_t> PitchBends = 0;
+        std::atomic<size_t> ChannelPressure = 0;
+    };
+
+  private:
+    // What has already been seen further down the batch, per channel
+    struct ChannelState {
+        uint64_t cc[2];
+        bool pitchBend;
+        bool pressure;
+    };
+
+    ChannelState channels[16] = {};
+    Stats stats;
+
+    static constexpr bool IsCoalescableCC(uint8_t cc) {
+        switch (cc) {
+        // Bank select
+        case 0:
+        case 32:
+        // Data entry and RPN/NRPN
+        case 6:
+        case 38:
+        case 96:
+        case 97:
+        case 98:
+        case 99:
+        case 100:
+        case 101:
+            return false;
+
+        default:
+            // 120 and up are channel mode messages
+            return cc < 120;
+        }
+    }
+
+  public:
+    // Empties the superseded events in place (consumers skip them), returns
+    // how many got removed
+    size_t Process(std::span<ShortEvent> evs);
+
+    const Stats &GetStats() const { return stats; }
+};
+} // namespace OmniMIDI
+
+#endif
@@ -0,0 +1,222 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+#include "RenderInstance.hpp"
+#include <cmath>
+#include <stdexcept>
+
+OmniMIDI::RenderInstance::RenderInstance(ErrorSystem::Logger *pErr,
+                                         uint32_t sampleRate,
+                                         uint32_t audioChannels,
+                                         size_t evbufCapacity,
+                                         bool timestamps) {
+    ErrLog = pErr;
+    silence_tail = (uint64_t)sampleRate * audioChannels *
+                   RENDER_SILENCE_TAIL_MS / 1000;
+
+    if (!staging.Allocate(evbufCapacity))
+        throw std::runtime_error("Failed to allocate the event queue!");
+
+    // When the renderer falls this far behind, shed note ons first and
+    // keep the rest of the ring for the note offs
+    staging.SetOverflowPolicy(OverflowDropNoteOns);
+
+    if (timestamps) {
+        if (!staging.EnableTimestamps())
+            throw std::runtime_error("Failed to allocate the event stamps!");
+
+        timed = true;
+    }
+}
+
+void OmniMIDI::RenderInstance::SendEvent(uint32_t event, uint64_t stamp) {
+    staging.Write(event, stamp);
+    MarkPending();
+}
+
+// Queued like any other event, so it lands after everything sent before
+// it, StreamQueuedEvents() applies it
+void OmniMIDI::RenderInstance::ResetStream(uint8_t type, uint64_t stamp) {
+    staging.Write(SystemReset | (type << 8), stamp);
+    MarkPending();
+}
+
+// The ThreadManager set the slot's reference count before calling this,
+// StreamQueuedEvents() gives the reference back once it's played
+bool OmniMIDI::RenderInstance::QueueLongEvent(uint32_t slot, uint64_t stamp) {
+    if (!staging.Write(SystemMessageStart | (slot << 8), stamp))
+        return false;
+
+    MarkPending();
+    return true;
+}
+
+// Hands everything queued so far to the engine, the second pass is for
+// when the ring isn't mirrored and the events wrap around its end
+void OmniMIDI::RenderInstance::FlushEvents() {
+    for (int part = 0; part < 2; part++) {
+        std::span<ShortEvent> evs = staging.AcquireReadable();
+        if (evs.empty())
+            break;
+
+        StreamQueuedEvents(evs.data(), evs.size());
+        staging.Release(evs.size());
+    }
+}
+
+int OmniMIDI::RenderInstance::Render(float *buffer, size_t count) {
+    FlushEvents();
+    return RenderSamples(buffer, count);
+}
+
+// Renders count samples, applying each queued event at the offset its
+// timestamp maps to within [windowStart, windowStart + windowLen).
+// The block is rendered in slices, one per group of events that land on
+// the same offset. Events older than the window play at the start of the
+// block, ones newer than it stay queued for the next block.
+int OmniMIDI::RenderInstance::RenderTimed(float *buffer, size_t count,
+                                          uint32_t channels,
+                                          uint64_t windowStart,
+                                          uint64_t windowLen) {
+    if (!timed)
+        return Render(buffer, count);
+
+    const size_t frames = count / channels;
+    const uint64_t windowEnd = windowStart + windowLen;
+
+    // Sample offset of a timestamp, rounded down to the quantum
+    auto offsetOf = [&](uint64_t stamp) -> size_t {
+        if (stamp <= windowStart)
+            return 0;
+
+        size_t offset = (size_t)((stamp - windowStart) * frames / windowLen);
+        return offset - (offset % RENDER_TIMED_QUANTUM);
+    };
+
+    auto render = [&](size_t from, size_t to) -> int {
+        int res = RenderSamples(buffer + (from * channels),
+                                (to - from) * channels);
+        return res > 0 ? res : 0;
+    };
+
+    size_t pos = 0;
+    int ret = 0;
+
+    // The events are read in place, without the mirror a run that wraps
+    // around the end of the ring comes in two parts
+    for (int part = 0; part < 2; part++) {
+        std::span<ShortEvent> evs = staging.AcquireReadable();
+        const uint64_t *stamps = staging.ReadableStamps();
+        size_t len = 0;
+
+        // Take everything captured before the end of the window,
+        // and leave the rest where it is
+        while (len < evs.size() && stamps[len] < windowEnd)
+            len++;
+
+        size_t i = 0;
+        while (i < len) {
+            // Never go back in time, events have to stay in order
+            size_t offset = offsetOf(stamps[i]);
+            if (offset > pos) {
+                ret += render(pos, offset);
+                pos = offset;
+            }
+
+            // Send every event that falls into the current slice at once
+            size_t run = i + 1;
+            while (run < len && offsetOf(stamps[run]) <= pos)
+                run++;
+
+            StreamQueuedEvents(evs.data() + i, run - i);
+            i = run;
+        }
+
+        staging.Release(len);
+
+        // The leftovers are due next block, which can't be skipped then
+        if (len < evs.size()) {
+            MarkPending();
+            break;
+        }
+
+        if (evs.empty())
+            break;
+    }
+
+    if (pos < frames)
+        ret += render(pos, frames);
+
+    return ret;
+}
+
+bool OmniMIDI::RenderInstance::IsIdle() {
+    if (pending.exchange(false, std::memory_order_acquire))
+        return false;
+
+    return silent_samples >= silence_tail;
+}
+
+void OmniMIDI::RenderInstance::TrackSilence(const float *buffer,
+                                            size_t count, uint64_t voices) {
+    if (voices) {
+        silent_samples = 0;
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (fabsf(buffer[i]) > RENDER_SILENCE_LEVEL) {
+            silent_samples = 0;
+            return;
+        }
+    }
+
+    silent_samples += count;
+}
+
+// Plays a run of queued events in one go, except for the resets queued by
+// ResetStream() and the long messages queued by QueueLongEvent(), which
+// split the run
+void OmniMIDI::RenderInstance::StreamQueuedEvents(const uint32_t *events,
+                                                  size_t count) {
+    size_t start = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        const uint32_t status = events[i] & 0xFF;
+        if (status != SystemReset && status != SystemMessageStart)
+            continue;
+
+        if (i > start)
+            PlayEvents(events + start, i - start);
+
+        if (status == SystemReset) {
+            PlayReset((events[i] >> 8) & 0xFF);
+        } else if (longSlots) {
+            LongEventSlot &slot = longSlots[events[i] >> 8];
+
+            PlayLongEvent(slot.data.data(), slot.data.size());
+            slot.refs.fetch_sub(1, std::memory_order_release);
+        }
+
+        start = i + 1;
+    }
+
+    if (count > start)
+        PlayEvents(events + start, count - start);
+}
@@ -0,0 +1,135 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+#ifndef _RENDERINSTANCE_H
+#define _RENDERINSTANCE_H
+
+#pragma once
+
+#include "../ErrSys.hpp"
+#include "../EvBuf_t.hpp"
+#include "SynthModule.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Smallest slice of a block RenderInstance::RenderTimed() will render,
+// in frames, so that dense passages don't split a block into slivers
+#define RENDER_TIMED_QUANTUM 32
+
+// How long an instance has to stay below RENDER_SILENCE_LEVEL, with no
+// voices and no new events, before RenderInstance::IsIdle() lets the
+// multithreaded renderer skip it. Long enough for the reverb and chorus
+// tails to die out.
+#define RENDER_SILENCE_TAIL_MS 500
+#define RENDER_SILENCE_LEVEL 1.0e-6f // -120 dBFS
+
+namespace OmniMIDI {
+// A long message shared by the instances it was sent to, see
+// ThreadManager::SendLongEvent(). refs counts the ones that still have to
+// play it, the slot can't be reused before it drops to zero.
+struct LongEventSlot {
+    std::atomic<uint32_t> refs = 0;
+    std::vector<uint8_t> data;
+};
+
+// One synth instance of the multithreaded renderer, see ThreadManager.
+// It owns a slice of the keyboard of a single MIDI channel, and always
+// gets its events on channel 0. The GS and XG part parameters it gets are
+// pointed at the part of PartChannel() instead.
+//
+// The engine-independent part lives here: the events are queued by
+// SendEvent() and ResetStream(), in a single producer ring, so one thread
+// can send while another one renders. Render() and RenderTimed() then
+// hand them to the engine through PlayEvents() and PlayReset(), and pull
+// the audio through RenderSamples(), all on the thread that renders.
+class RenderInstance {
+  public:
+    RenderInstance(ErrorSystem::Logger *pErr, uint32_t sampleRate,
+                   uint32_t audioChannels, size_t evbufCapacity,
+                   bool timestamps);
+    virtual ~RenderInstance() = default;
+
+    RenderInstance(const RenderInstance &) = delete;
+    RenderInstance &operator=(const RenderInstance &) = delete;
+
+    void SendEvent(uint32_t event, uint64_t stamp = 0);
+    void ResetStream(uint8_t type, uint64_t stamp = 0);
+    void FlushEvents();
+
+    // Queues the long message held by one of the slots passed to
+    // SetLongEventSlots(), in order with the other events. False if the
+    // queue had no room for it, the caller keeps its reference then
+    bool QueueLongEvent(uint32_t slot, uint64_t stamp = 0);
+    void SetLongEventSlots(LongEventSlot *slots) { longSlots = slots; }
+
+    // count is in samples, all the channels included
+    int Render(float *buffer, size_t count);
+    int RenderTimed(float *buffer, size_t count, uint32_t channels,
+                    uint64_t windowStart, uint64_t windowLen);
+
+    // Silence tracking, for the multithreaded renderer. IsIdle() is true
+    // when nothing was sent since the last check and the output has been
+    // silent for RENDER_SILENCE_TAIL_MS, so rendering would only give
+    // zeros. TrackSilence() has to be fed every rendered block.
+    bool IsIdle();
+    void TrackSilence(const float *buffer, size_t count, uint64_t voices);
+
+    virtual uint64_t VoiceCount() = 0;
+
+    // The channel the engine actually plays the events on
+    virtual uint8_t PartChannel() const { return 0; }
+
+    // fonts is an array of the engine's own soundfont handles, loaded once
+    // by the synth module and shared by all of its instances:
+    // BASS_MIDI_FONTEX for BASSMIDI, XSynth_Soundfont for XSynth, and
+    // the paths as const char * for FluidSynth. No fonts clears the list.
+    virtual bool SetSoundFonts(const void *fonts, size_t count) = 0;
+
+  protected:
+    ErrorSystem::Logger *ErrLog = nullptr;
+
+    // For the events that don't go through the queue
+    void MarkPending() { pending.store(true, std::memory_order_relaxed); }
+
+    virtual void PlayEvents(const uint32_t *events, size_t count) = 0;
+    virtual void PlayReset(uint8_t type) = 0;
+    // Engines without SysEx support can ignore them, the resets still reach
+    // them through PlayReset()
+    virtual void PlayLongEvent(const uint8_t *data, size_t len) {}
+    virtual int RenderSamples(float *buffer, size_t count) = 0;
+
+  private:
+    // Events waiting for the next render, stamped for timed instances,
+    // see RenderTimed()
+    EvBuf staging;
+    bool timed = false;
+    LongEventSlot *longSlots = nullptr;
+
+    // Set whenever an event is sent, cleared by IsIdle()
+    std::atomic<bool> pending = true;
+    uint64_t silent_samples = 0;
+    uint64_t silence_tail = 0;
+
+    void StreamQueuedEvents(const uint32_t *events, size_t count);
+};
+} // namespace OmniMIDI
+
+#endif
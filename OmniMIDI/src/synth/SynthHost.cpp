@@ -391,6 +391,14 @@ uint64_t OmniMIDI::SynthHost::GetActiveVoices() {
     return Synth->GetActiveVoices();
 }
 
+void OmniMIDI::SynthHost::GetEventStats(EvBufMetrics &m) {
+    Synth->GetEventStats(m);
+}
+
+void OmniMIDI::SynthHost::GetAudioStats(AudioMetrics &m) {
+    Synth->GetAudioStats(m);
+}
+
 void OmniMIDI::SynthHost::PlayShortEvent(uint32_t ev) {
     // uint8_t status = (ev >> 0) & 0xFF;
     // uint8_t param1 = (ev >> 8) & 0xFF;
@@ -425,7 +433,6 @@ OmniMIDI::SynthResult OmniMIDI::SynthHost::PlayLongEvent(char *ev,
     for (int32_t readHead = 0, n = size - 1; readHead < n;) {
         switch (ev[readHead] & 0xF0) {
         case SystemMessageStart: {
-            bool notSpecial = false;
             uint8_t vendor = ev[readHead + 1] & 0xFF;
 
             readHead += 2;
@@ -476,8 +483,10 @@ OmniMIDI::SynthResult OmniMIDI::SynthHost::PlayLongEvent(char *ev,
                         readHead += 5;
                         break;
 
+                    // Master volume and friends, let the synth handle them
                     default:
-                        return NotSupported;
+                        Synth->PlayLongEvent((uint8_t *)ev, size);
+                        return Ok;
                     }
 
                     return Ok;
@@ -855,15 +864,12 @@ OmniMIDI::SynthResult OmniMIDI::SynthHost::PlayLongEvent(char *ev,
                     break;
                 }
 
+                // Everything else goes to the synth as is
                 default:
-                    notSpecial = true;
-                    readHead += 5;
-                    break;
+                    Synth->PlayLongEvent((uint8_t *)ev, size);
+                    return Ok;
                 }
 
-                if (notSpecial)
-                    continue;
-
                 return Ok;
             }
 
@@ -103,6 +103,8 @@ class SynthHost {
     void PlayShortEvent(uint8_t status, uint8_t param1, uint8_t param2);
     float GetRenderingTime();
     uint64_t GetActiveVoices();
+    void GetEventStats(EvBufMetrics &m);
+    void GetAudioStats(AudioMetrics &m);
     SynthResult PlayLongEvent(char *ev, uint32_t size);
     SynthResult Reset() { return Synth->Reset(); }
     SynthResult TalkToSynthDirectly(uint32_t evt, uint32_t chan,
@@ -18,6 +18,7 @@
  */
 
 #include "SynthModule.hpp"
+#include <algorithm>
 #include <inttypes.h>
 #include <iostream>
 
@@ -45,27 +46,75 @@ void OmniMIDI::SynthModule::StopDebugOutput() {
 }
 
 void OmniMIDI::SynthModule::LogFunc() {
-    const char Templ[] = "R%06.2f%% >> P%" PRIu64 " (Ev%08zu/%08zu)";
-    char *Buf = new char[96];
+    const char Templ[] = "R%06.2f%% >> P%" PRIu64 " (Ev%08zu/%08zu) U%" PRIu64
+                         " (L%" PRIu64 ")";
+    char *Buf = new char[128];
+    AudioMetrics m;
 
     while (!IsSynthInitialized())
         Utils.MicroSleep(SLEEPVAL(1));
 
     while (IsSynthInitialized()) {
+        GetAudioStats(m);
         sprintf(Buf, Templ, GetRenderingTime(), GetActiveVoices(),
-                ShortEvents->GetReadHeadPos(), ShortEvents->GetWriteHeadPos());
+                ShortEvents->GetReadHeadPos(), ShortEvents->GetWriteHeadPos(),
+                m.Underruns, m.LateSamples);
         SetTerminalTitle(Buf);
 
         Utils.MicroSleep(SLEEPVAL(1000));
     }
 
-    sprintf(Buf, Templ, 0.0f, (uint64_t)0, (size_t)0, (size_t)0);
+    sprintf(Buf, Templ, 0.0f, (uint64_t)0, (size_t)0, (size_t)0, (uint64_t)0,
+            (uint64_t)0);
     SetTerminalTitle(Buf);
 
     delete[] Buf;
 }
 
-void OmniMIDI::SynthModule::FreeEvBuf(BEvBuf *target) {
+bool OmniMIDI::SynthModule::LogEventStats(bool force) {
+    const uint64_t now = EvBufTime();
+
+    if (!force && now - LastEventStatsLog < EVSTATS_LOG_INTERVAL)
+        return false;
+
+    LastEventStatsLog = now;
+
+    EvBufMetrics m;
+    GetEventStats(m);
+
+    uint64_t dropped = 0, dispatched = 0;
+    for (size_t i = 0; i < EVBUF_EVENT_TYPES; i++)
+        dropped += m.Dropped[i];
+    for (size_t i = 0; i < EVBUF_LATENCY_BUCKETS; i++)
+        dispatched += m.Latency[i];
+
+    // Upper bounds of the buckets holding the median and the 99th percentile
+    uint64_t p50 = 0, p99 = 0, seen = 0;
+    for (size_t i = 0; i < EVBUF_LATENCY_BUCKETS && dispatched; i++) {
+        seen += m.Latency[i];
+
+        if (!p50 && seen * 2 >= dispatched)
+            p50 = 2ULL << i;
+
+        if (!p99 && seen * 100 >= dispatched * 99) {
+            p99 = 2ULL << i;
+            break;
+        }
+    }
+
+    Message("EvStats >> in=%" PRIu64 " out=%" PRIu64 " dropped=%" PRIu64
+            " noteoff=%" PRIu64 " noteon=%" PRIu64 " cc=%" PRIu64
+            " blocked=%" PRIu64 " evicted=%" PRIu64 " coalesced=%" PRIu64
+            " hwm=%" PRIu64 "/%" PRIu64 " p50<%" PRIu64 "ns p99<%" PRIu64
+            "ns",
+            m.EventsIn, m.EventsOut, dropped, m.Dropped[0], m.Dropped[1],
+            m.Dropped[3], m.Blocked, m.Evicted, m.Coalesced, m.HighWater,
+            m.Capacity, p50, p99);
+
+    return true;
+}
+
+void OmniMIDI::SynthModule::FreeEvBuf(BEvBuf *&target) {
     if (target) {
         auto tEvents = new BEvBuf;
         auto oEvents = target;
@@ -78,7 +127,7 @@ void OmniMIDI::SynthModule::FreeEvBuf(BEvBuf *target) {
 
 OmniMIDI::BEvBuf *OmniMIDI::SynthModule::AllocateShortEvBuf(size_t size) {
     if (ShortEvents) {
-        auto tEvents = new EvBuf(size);
+        auto tEvents = new MPSCEvBuf(size);
         auto oEvents = ShortEvents;
 
         ShortEvents = tEvents;
@@ -212,6 +261,17 @@ bool OmniMIDI::SettingsModule::WriteConfig() {
     return true;
 }
 
+OmniMIDI::RTConfig OmniMIDI::SettingsModule::GetRTConfig() {
+    RTConfig cfg;
+
+    cfg.Policy = RTPolicy > RTPOLICY_COUNT ? RTNone : RTPolicy;
+    cfg.Priority = std::clamp(RTPriority, 1, 99);
+    cfg.CPUs = RTThread::ParseCPUSet(RTAffinity);
+    cfg.LockMemory = LockMemory;
+
+    return cfg;
+}
+
 bool OmniMIDI::SettingsModule::ReloadConfig() {
     JSONStream->close();
     return InitConfig();
@@ -33,6 +33,7 @@
 
 #include "../ErrSys.hpp"
 #include "../EvBuf_t.hpp"
+#include "../RTThread.hpp"
 #include "../Utils.hpp"
 #include "nlohmann/json.hpp"
 
@@ -64,6 +65,9 @@
         break;
 
 #define SYNTHNAME_SZ 64
+
+// How often the event pipeline counters get logged, in ns
+#define EVSTATS_LOG_INTERVAL 10000000000ULL
 #define DUMMY_STR "dummy"
 #define EMPTYMODULE 0xDEADBEEF
 
@@ -351,6 +355,12 @@ class SettingsModule {
     uint32_t SampleRate = 48000;
     uint32_t VoiceLimit = 1024;
 
+    // Render thread scheduling, see RTThread.hpp
+    uint32_t RTPolicy = RTNone;
+    int32_t RTPriority = 70;
+    std::string RTAffinity = "";
+    bool LockMemory = false;
+
     SettingsModule(ErrorSystem::Logger *PErr) {
         JSONStream = new std::fstream;
         ErrLog = PErr;
@@ -370,6 +380,7 @@ class SettingsModule {
     virtual const bool IsOwnConsole() { return OwnConsole; }
     virtual const bool IsDebugMode() { return DebugMode; }
     virtual const char *GetCustomRenderer() { return CustomRenderer.c_str(); }
+    virtual RTConfig GetRTConfig();
 
     virtual bool InitConfig(bool write = false,
                             const char *pSynthName = nullptr,
@@ -406,6 +417,7 @@ class SynthModule {
 
     uint64_t ActiveVoices = 0;
     float RenderingTime = 0.0f;
+    uint64_t LastEventStatsLog = 0;
 
     BEvBuf *ShortEvents = new BaseEvBuf_t;
     BEvBuf *LongEvents = new BaseEvBuf_t;
@@ -414,7 +426,11 @@ class SynthModule {
     virtual void StopDebugOutput();
     virtual void LogFunc();
 
-    virtual void FreeEvBuf(BEvBuf *target);
+    // Logs the event pipeline counters, at most once per
+    // EVSTATS_LOG_INTERVAL unless forced, returns true if it did
+    bool LogEventStats(bool force = false);
+
+    virtual void FreeEvBuf(BEvBuf *&target);
 
     virtual BEvBuf *AllocateShortEvBuf(size_t size);
     virtual BEvBuf *AllocateLongEvBuf(size_t size);
@@ -469,6 +485,9 @@ class SynthModule {
     virtual uint32_t SynthID() { return EMPTYMODULE; }
     virtual uint64_t GetActiveVoices() { return ActiveVoices; }
     virtual float GetRenderingTime() { return RenderingTime; }
+    virtual void GetEventStats(EvBufMetrics &m) { ShortEvents->GetMetrics(m); }
+    // Only the modules that play through a BufferedRenderer have any
+    virtual void GetAudioStats(AudioMetrics &m) { m = {}; }
 
 #ifdef _WIN32
     virtual void SetInstance(HMODULE hModule) { m_hModule = hModule; }
@@ -508,6 +527,60 @@ class SynthModule {
     }
 };
 
+// Engines that queue their short events in one of the rings from EvBuf_t.hpp
+// should derive from this rather than SynthModule. The ring type is bound at
+// compile time, so past the first virtual call from SynthHost, the event
+// goes straight into the ring's Write(), which can be inlined.
+template <class T> class BufferedSynthModule : public SynthModule {
+  protected:
+    // Same object as ShortEvents, without the type erasure
+    T *Events = nullptr;
+
+    BEvBuf *AllocateShortEvBuf(size_t size) override {
+        auto tEvents = new T(size);
+        auto oEvents = ShortEvents;
+
+        Events = tEvents;
+        ShortEvents = tEvents;
+
+        delete oEvents;
+        return ShortEvents;
+    }
+
+    void FreeShortEvBuf() override {
+        auto oEvents = ShortEvents;
+
+        Events = nullptr;
+        ShortEvents = new BaseEvBuf_t;
+
+        delete oEvents;
+    }
+
+  public:
+    BufferedSynthModule() : SynthModule() {}
+    BufferedSynthModule(ErrorSystem::Logger *PErr) : SynthModule(PErr) {}
+
+    // Event handling system
+    void PlayShortEvent(uint32_t ev) final {
+        if (!Events)
+            return;
+
+        Events->Write(ev);
+    }
+    void PlayShortEvent(uint8_t status, uint8_t param1,
+                        uint8_t param2) final {
+        if (!Events)
+            return;
+
+        Events->Write(status | (param1 << 8) | (param2 << 16));
+    }
+    void UPlayShortEvent(uint32_t ev) final { Events->Write(ev); }
+    void UPlayShortEvent(uint8_t status, uint8_t param1,
+                         uint8_t param2) final {
+        Events->Write(status | (param1 << 8) | (param2 << 16));
+    }
+};
+
 class SoundFontSystem {
   private:
     ErrorSystem::Logger *ErrLog = nullptr;
@@ -0,0 +1,797 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+#include "ThreadMgr.hpp"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <sys/types.h>
+
+void ThreadFunc(OmniMIDI::ThreadManager::ThreadInfo *info);
+void MixChunks(OmniMIDI::ThreadManager::ThreadSharedInfo *shared);
+
+// GM system on/off, GS and XG resets. Returns the type SystemReset takes
+// for them, see BASSInstance::PlayReset(), or -1 for anything else
+static int32_t SysExResetType(const uint8_t *ev, size_t len) {
+    // F0 7E <dev> 09 <01: GM1 on, 02: GM off, 03: GM2 on> F7
+    static constexpr int32_t gm_types[] = {-1, 0x02, 0x00, 0x03};
+    // F0 41 <dev> 42 12 40 00 7F 00 41 F7
+    static constexpr uint8_t gs_reset[] = {0x42, 0x12, 0x40, 0x00,
+                                          0x7F, 0x00, 0x41};
+    // F0 43 1<dev> 4C 00 00 7E 00 F7
+    static constexpr uint8_t xg_reset[] = {0x4C, 0x00, 0x00, 0x7E, 0x00};
+
+    if (len == 6 && ev[1] == 0x7E && ev[3] == 0x09 && ev[4] >= 0x01 &&
+        ev[4] <= 0x03)
+        return gm_types[ev[4]];
+
+    if (len == 11 && ev[1] == 0x41 &&
+        !memcmp(ev + 3, gs_reset, sizeof(gs_reset)))
+        return 0x01;
+
+    if (len == 9 && ev[1] == 0x43 && (ev[2] & 0xF0) == 0x10 &&
+        !memcmp(ev + 3, xg_reset, sizeof(xg_reset)))
+        return 0x04;
+
+    return -1;
+}
+
+// GS part parameters (F0 41 <dev> 42 12 40 <1x, 2x or 4x> ...) and XG
+// multi part ones (F0 43 1<dev> 4C 08 <part> ...) only concern the MIDI
+// channel of their part. Returns it, with the position of the byte that
+// holds the part, or -1 for anything else
+static int32_t SysExPartChannel(const uint8_t *ev, size_t len,
+                                size_t &pos) {
+    using namespace OmniMIDI;
+
+    if (len >= 10 && ev[1] == 0x41 && ev[3] == 0x42 && ev[4] == Receive &&
+        ev[5] == 0x40) {
+        switch (ev[6] & 0xF0) {
+        case 0x10:
+        case 0x20:
+        case 0x40: {
+            // GS numbers the parts from the rhythm part, on channel 10
+            const int32_t part = ev[6] & 0x0F;
+
+            pos = 6;
+            return part == 0 ? 9 : (part <= 9 ? part - 1 : part);
+        }
+
+        default:
+            return -1;
+        }
+    }
+
+    if (len >= 8 && ev[1] == 0x43 && (ev[2] & 0xF0) == 0x10 &&
+        ev[3] == 0x4C && ev[4] == 0x08 && ev[5] < 16) {
+        pos = 5;
+        return ev[5];
+    }
+
+    return -1;
+}
+
+// Points a part parameter found by SysExPartChannel() at the part that
+// plays channel, the one the instances play their events on
+static void SysExRetarget(uint8_t *ev, size_t len, size_t pos,
+                          uint8_t channel) {
+    using namespace OmniMIDI;
+
+    if (ev[1] == 0x43) {
+        ev[pos] = channel;
+        return;
+    }
+
+    // The inverse of SysExPartChannel()
+    const uint8_t part =
+        channel == 9 ? 0 : (channel < 9 ? channel + 1 : channel);
+    ev[pos] = (ev[pos] & 0xF0) | part;
+
+    // The Roland checksum covers the address and the data
+    uint32_t sum = 0;
+    for (size_t i = 5; i < len - 2; i++)
+        sum += ev[i];
+
+    ev[len - 2] = (uint8_t)((ChecksumDividend - (sum % ChecksumDividend)) %
+                            ChecksumDividend);
+}
+
+OmniMIDI::ThreadManager::ThreadManager(ErrorSystem::Logger *PErr,
+                                       const ThreadManagerConfig &cfg,
+                                       InstanceFactory factory) {
+    ErrLog = PErr;
+
+    sample_rate = cfg.SampleRate;
+    uint16_t audio_channels = cfg.AudioChannels;
+
+    kbdiv = std::clamp(cfg.KeyboardDivisions, 1u, 128u);
+    shared.num_instances = kbdiv * 16;
+    if (cfg.ThreadCount == 0 || cfg.ThreadCount > shared.num_instances) {
+        shared.num_threads = shared.num_instances;
+    } else {
+        shared.num_threads = cfg.ThreadCount;
+    }
+
+    size_t render_size = std::max(cfg.RenderSize, (size_t)1);
+
+    // The instance buffers have to fit the biggest block the renderer
+    // can tune itself up to
+    BufferedRenderer::AutoTune tune = {
+        std::min(std::max(cfg.MinRenderSize, (size_t)1), render_size),
+        cfg.MaxRenderSize, cfg.LatencyBias};
+    size_t buffer_len =
+        std::max(render_size, tune.max_size) * (size_t)audio_channels;
+
+    // One arena for all the instance buffers, each starting on its own
+    // cache line so the workers never write to the same one
+    size_t buffer_stride = Mixdown::Stride(buffer_len);
+    shared.instance_arena =
+        Mixdown::AllocArena(buffer_stride * shared.num_instances);
+    shared.instance_buffers = new float *[shared.num_instances] {};
+
+    Message("Creating %d instances. Allocated buffer len: %zu "
+            "(mixdown: %s)",
+            shared.num_instances, buffer_len, Mixdown::KernelName());
+
+    shared.instances = new RenderInstance *[shared.num_instances] {};
+    shared.instance_order = new uint32_t[shared.num_instances];
+    shared.instance_cost = new uint64_t[shared.num_instances]{};
+    shared.instance_skipped = new uint8_t[shared.num_instances]{};
+    shared.mix_srcs = new const float *[shared.num_instances] {};
+    shared.num_mix_srcs = 0;
+    shared.instance_load =
+        new ThreadSharedInfo::InstanceLoad[shared.num_instances];
+    shared.load_round.store(0, std::memory_order_relaxed);
+
+    long_slots = new LongEventSlot[THREADMGR_LONGEV_SLOTS];
+    for (uint32_t i = 0; i < THREADMGR_LONGEV_SLOTS; i++)
+        long_slots[i].data.reserve(THREADMGR_LONGEV_RESERVE);
+
+    for (uint32_t i = 0; i < shared.num_instances; i++) {
+        shared.instances[i] = factory(i / kbdiv, i % kbdiv);
+        shared.instances[i]->SetLongEventSlots(long_slots);
+        shared.instance_buffers[i] =
+            shared.instance_arena + buffer_stride * (size_t)i;
+        shared.instance_order[i] = i;
+    }
+
+    shared.nps = new NpsLimiter(shared.num_instances, cfg.MaxInstanceNPS);
+
+    adaptive_routing = cfg.AdaptiveRouting;
+    routed_pending = new uint32_t[shared.num_instances]{};
+    memset(key_held, 0, sizeof(key_held));
+    for (uint32_t c = 0; c < 16; c++) {
+        for (uint32_t k = 0; k < 128; k++)
+            key_route[c][k] = (uint8_t)(k % kbdiv);
+    }
+
+    if (adaptive_routing)
+        Message("Adaptive key routing enabled");
+
+    Message("Creating %d threads", shared.num_threads);
+
+    shared.barrier.SetWorkers(shared.num_threads);
+
+    shared.timed_events = cfg.TimedEvents;
+    shared.audio_channels = audio_channels;
+    shared.window_start = 0;
+    shared.window_len = 0;
+    shared.mixing = false;
+    shared.mix_out = nullptr;
+
+    shared.rt = cfg.RT;
+    shared.log = ErrLog;
+
+    shared.cursor.store(0, std::memory_order_relaxed);
+    threads = new ThreadInfo[shared.num_threads];
+    last_busy_total = new uint64_t[shared.num_threads]{};
+
+    for (uint32_t i = 0; i < shared.num_threads; i++) {
+        ThreadInfo *t = &threads[i];
+        t->thread_idx = i;
+        t->shared = &shared;
+
+        t->thread = std::jthread(ThreadFunc, t);
+    }
+
+    AudioStreamParams stream_params{sample_rate, audio_channels};
+    auto render_func = [self = this](float *buffer, size_t count) {
+        self->ReadSamples(buffer, count);
+    };
+
+    // The render and device threads float over the whole CPU set, pinning
+    // is for the workers
+    auto render_init = [rt = shared.rt, PErr]() {
+        RTThread::Promote(PErr, rt, "Render");
+    };
+    auto audio_init = [rt = shared.rt, PErr]() {
+        RTThread::Promote(PErr, rt, "Audio");
+    };
+
+    if (tune.max_size > tune.min_size) {
+        Message("Initializing buffered renderer: RenderSize=%zu samples "
+                "(auto, %zu-%zu, bias %u)",
+                render_size, tune.min_size, tune.max_size, tune.bias);
+    } else {
+        Message("Initializing buffered renderer: RenderSize=%zu samples",
+                render_size);
+    }
+
+    buffered = new BufferedRenderer(render_func, stream_params, render_size,
+                                    render_init, tune);
+
+    Message("Initializing audio playback system");
+
+    auto audio_pipe = [self = buffered, audio_channels](float *buffer,
+                                                         size_t frames) {
+        self->read(buffer, frames * audio_channels);
+    };
+    audio_player = new MIDIAudioPlayer(PErr, sample_rate, audio_channels,
+                                       cfg.AudioLimiter, audio_pipe,
+                                       audio_init);
+
+    // Last, once the worker stacks, the sample ring and the device buffers
+    // are all mapped, mlockall only covers what's mapped. Everything on the
+    // render path was faulted in when it was allocated: AllocArena() zeroes
+    // the arena, and the renderer prefaults its ring
+    if (shared.rt.LockMemory)
+        RTThread::LockMemory(ErrLog);
+
+    Message("ThreadManager intialization successful");
+}
+
+OmniMIDI::ThreadManager::~ThreadManager() {
+    Message("Stopping ThreadManager");
+
+    delete audio_player;
+    delete buffered;
+
+    shared.barrier.Shutdown();
+
+    Message("Waiting for threads to exit");
+    for (uint32_t i = 0; i < shared.num_threads; i++) {
+        threads[i].thread.join();
+    }
+
+    for (uint32_t i = 0; i < shared.num_instances; i++) {
+        delete shared.instances[i];
+    }
+
+    delete[] shared.instances;
+    delete[] long_slots;
+    delete shared.nps;
+
+    delete[] shared.instance_buffers;
+    Mixdown::FreeArena(shared.instance_arena);
+    delete[] shared.instance_order;
+    delete[] shared.instance_cost;
+    delete[] shared.instance_skipped;
+    delete[] shared.mix_srcs;
+    delete[] shared.instance_load;
+    delete[] routed_pending;
+    delete[] threads;
+    delete[] last_busy_total;
+}
+
+void OmniMIDI::ThreadManager::SendEvent(uint32_t event, uint64_t stamp) {
+    const uint32_t head = event & 0xFF;
+    const uint32_t channel = head & 0xF;
+    const uint32_t code = head >> 4;
+    uint32_t ev;
+
+    // Slot emptied by the overflow policy
+    if (!(head & 0x80))
+        return;
+
+    switch (code) {
+    case 0x9: // Note on
+        // Zero velocity is a note off, and has to be routed like one
+        if ((event >> 16) & 0xFF) {
+            ev = event & 0xFFFFF0;
+            const uint32_t key = (ev >> 8) & 0x7F;
+            const uint32_t vel = (ev >> 16) & 0xFF;
+            const uint32_t idx = adaptive_routing
+                                     ? RouteNoteOn(channel, key)
+                                     : (channel * kbdiv) + (key % kbdiv);
+
+            if (shared.nps->note_on(idx, key, vel)) {
+                shared.instances[idx]->SendEvent(ev, stamp);
+            }
+
+            break;
+        }
+        [[fallthrough]];
+
+    case 0x8: { // Note Off
+        ev = event & 0xFFFFF0;
+        const uint32_t key = (ev >> 8) & 0x7F;
+        const uint32_t idx = adaptive_routing
+                                 ? RouteNoteOff(channel, key)
+                                 : (channel * kbdiv) + (key % kbdiv);
+
+        if (shared.nps->note_off(idx, key)) {
+            shared.instances[idx]->SendEvent(ev, stamp);
+        }
+        break;
+    }
+
+    case 0xF: { // System
+        // A lone SysEx status means nothing without its data, and would
+        // pass for one of the markers from SendLongEvent()
+        if (head == SystemMessageStart)
+            break;
+
+        if (head == SystemReset) {
+            ev = event & 0xFFFFF0;
+            const uint32_t type = (ev >> 8) & 0xFF;
+
+            shared.nps->reset();
+            memset(key_held, 0, sizeof(key_held));
+            for (uint32_t i = 0; i < shared.num_instances; i++) {
+                shared.instances[i]->ResetStream(type, stamp);
+            }
+        } else {
+            for (uint32_t i = 0; i < shared.num_instances; i++) {
+                shared.instances[i]->SendEvent(event, stamp);
+            }
+        }
+
+        break;
+    }
+
+    default: { // Other channel specific messages
+        ev = event & 0xFFFFF0;
+
+        // All sound off, all notes off and the mode changes (120, 123-127)
+        // release every key of the channel
+        if (code == 0xB && ((ev >> 8) & 0xFF) >= 120 &&
+            ((ev >> 8) & 0xFF) != 121 && ((ev >> 8) & 0xFF) != 122)
+            memset(key_held[channel], 0, sizeof(key_held[channel]));
+
+        for (uint32_t i = 0; i < kbdiv; i++) {
+            uint32_t idx = (channel * kbdiv) + i;
+            shared.instances[idx]->SendEvent(ev, stamp);
+        }
+    }
+    }
+}
+
+void OmniMIDI::ThreadManager::SendEvents(const uint32_t *events,
+                                             const uint64_t *stamps,
+                                             size_t count) {
+    if (!stamps) {
+        for (size_t i = 0; i < count; i++)
+            SendEvent(events[i]);
+
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++)
+        SendEvent(events[i], stamps[i]);
+}
+
+// Parses a long message once for all the instances. The resets go through
+// SendEvent() like SystemReset, the GS and XG part parameters only go to
+// the instances of the part's channel, and everything else goes to all of
+// them. The message is copied once, into a free slot, and every instance
+// it goes to gets a marker for it, so it plays in order with the events
+// sent before and after it.
+void OmniMIDI::ThreadManager::SendLongEvent(const uint8_t *data, size_t len,
+                                            uint64_t stamp) {
+    if (!data || len < 3 || data[0] != SystemMessageStart ||
+        data[len - 1] != SystemMessageEnd)
+        return;
+
+    const int32_t reset = SysExResetType(data, len);
+    if (reset >= 0) {
+        SendEvent(SystemReset | (reset << 8), stamp);
+        return;
+    }
+
+    size_t part_pos = 0;
+    const int32_t channel = SysExPartChannel(data, len, part_pos);
+    const uint32_t first = channel >= 0 ? (uint32_t)channel * kbdiv : 0;
+    const uint32_t count = channel >= 0 ? kbdiv : shared.num_instances;
+
+    LongEventSlot *slot = nullptr;
+    uint32_t idx = 0;
+    for (uint32_t n = 0; n < THREADMGR_LONGEV_SLOTS; n++) {
+        idx = (long_next + n) % THREADMGR_LONGEV_SLOTS;
+
+        if (!long_slots[idx].refs.load(std::memory_order_acquire)) {
+            slot = &long_slots[idx];
+            long_next = idx + 1;
+            break;
+        }
+    }
+
+    // Every slot is still waiting on an instance that's fallen behind
+    if (!slot) {
+        dropped_long.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    slot->data.assign(data, data + len);
+    if (channel >= 0)
+        SysExRetarget(slot->data.data(), len, part_pos,
+                      shared.instances[first]->PartChannel());
+
+    slot->refs.store(count, std::memory_order_release);
+    for (uint32_t i = first; i < first + count; i++) {
+        if (!shared.instances[i]->QueueLongEvent(idx, stamp)) {
+            slot->refs.fetch_sub(1, std::memory_order_release);
+            dropped_long.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+// The synth module left a placeholder in the run for every long message it
+// queued, each one gets sent in its place, so that it lands between the
+// events that came before and after it
+void OmniMIDI::ThreadManager::ForwardEvents(std::span<ShortEvent> evs,
+                                            const uint64_t *stamps,
+                                            BaseEvBuf_t *long_events) {
+    size_t start = 0;
+
+    for (size_t i = 0; i < evs.size(); i++) {
+        if ((evs[i] & 0xFF) != SystemMessageStart)
+            continue;
+
+        SendEvents(evs.data() + start, stamps ? stamps + start : nullptr,
+                   i - start);
+        start = i + 1;
+
+        // A lone SysEx status sent as a short event points to nothing
+        auto lev = long_events->AcquireLinked(evs[i]);
+        if (lev.empty())
+            continue;
+
+        SendLongEvent(lev.data(), lev.size(), stamps ? stamps[i] : 0);
+        long_events->ReleaseLinked(evs[i]);
+    }
+
+    SendEvents(evs.data() + start, stamps ? stamps + start : nullptr,
+               evs.size() - start);
+}
+
+void OmniMIDI::ThreadManager::ReadSamples(float *buffer,
+                                              size_t num_samples) {
+    // This block covers the last block's worth of time, so every event
+    // gets the same fixed delay instead of snapping to the block edge
+    if (shared.timed_events) {
+        shared.window_len = (uint64_t)(num_samples / shared.audio_channels) *
+                            1000000000ULL / sample_rate;
+        shared.window_start = EvBufTime() - shared.window_len;
+    }
+
+    shared.num_samples = num_samples;
+    shared.cursor.store(0, std::memory_order_relaxed);
+
+    shared.barrier.Dispatch();
+    shared.barrier.Wait(spinner);
+
+    // The instance loads are fresh, notes routed from now on count
+    // against this block
+    shared.load_round.fetch_add(1, std::memory_order_release);
+
+    // Costliest instances go first next time, so that the last ones to be
+    // picked up are the quick ones and the threads finish close together
+    std::sort(shared.instance_order,
+              shared.instance_order + shared.num_instances,
+              [&](uint32_t a, uint32_t b) {
+                  return shared.instance_cost[a] > shared.instance_cost[b];
+              });
+
+    // Only the instances that were rendered need mixing
+    uint32_t num_mix_srcs = 0;
+    for (uint32_t i = 0; i < shared.num_instances; i++) {
+        if (!shared.instance_skipped[i])
+            shared.mix_srcs[num_mix_srcs++] = shared.instance_buffers[i];
+    }
+
+    shared.num_mix_srcs = num_mix_srcs;
+    rendered_total.fetch_add(num_mix_srcs, std::memory_order_relaxed);
+    skipped_total.fetch_add(shared.num_instances - num_mix_srcs,
+                            std::memory_order_relaxed);
+
+    // Split the mixdown by sample range, this thread takes chunks too
+    // instead of just waiting for the workers
+    if (shared.num_threads > 1 && num_mix_srcs > 1 &&
+        num_samples > MIXDOWN_CHUNK) {
+        shared.mix_out = buffer;
+        shared.mixing = true;
+        shared.cursor.store(0, std::memory_order_relaxed);
+
+        shared.barrier.Dispatch();
+        MixChunks(&shared);
+        shared.barrier.Wait(spinner);
+
+        shared.mixing = false;
+    } else {
+        Mixdown::Sum(buffer, shared.mix_srcs, num_mix_srcs, 0, num_samples);
+    }
+
+    uint64_t active_voices = 0, busy_max = 0, busy_sum = 0;
+    for (uint32_t i = 0; i < shared.num_threads; i++) {
+        active_voices += threads[i].active_voices;
+        busy_max = std::max(busy_max, threads[i].busy);
+        busy_sum += threads[i].busy;
+    }
+
+    busy_max_total.fetch_add(busy_max, std::memory_order_relaxed);
+    busy_avg_total.fetch_add(busy_sum / shared.num_threads,
+                             std::memory_order_relaxed);
+
+    ActiveVoices.store(active_voices, std::memory_order_relaxed);
+}
+
+bool OmniMIDI::ThreadManager::SetSoundFonts(const void *fonts,
+                                            size_t count) {
+    for (uint32_t i = 0; i < shared.num_instances; i++) {
+        if (!shared.instances[i]->SetSoundFonts(fonts, count))
+            return false;
+    }
+
+    return true;
+}
+
+void OmniMIDI::ThreadManager::ClearSoundFonts() {
+    for (uint32_t i = 0; i < shared.num_instances; i++) {
+        shared.instances[i]->SetSoundFonts(nullptr, 0);
+    }
+}
+
+uint64_t OmniMIDI::ThreadManager::GetActiveVoices() {
+    return ActiveVoices.load(std::memory_order_relaxed);
+}
+
+// Read here rather than from ReadSamples(), which the render thread can
+// call before the constructor even got to set buffered
+float OmniMIDI::ThreadManager::GetRenderingTime() {
+    return buffered->average_renderer_load() * 100.0f;
+}
+
+void OmniMIDI::ThreadManager::GetAudioStats(AudioMetrics &m) {
+    buffered->get_metrics(m);
+}
+
+// Sends a note on to the least loaded of the channel's instances: the one
+// with the fewest voices as of the last block, counting the notes it got
+// since then, with the last block's render time breaking ties.
+// A key that's still held stays on its instance instead, so overlapping
+// notes and their note offs keep pairing up.
+uint32_t OmniMIDI::ThreadManager::RouteNoteOn(uint32_t channel,
+                                                  uint32_t key) {
+    const uint32_t base = channel * kbdiv;
+    uint8_t &route = key_route[channel][key];
+    uint16_t &held = key_held[channel][key];
+
+    // Only this thread writes the counters
+    routed_notes.store(routed_notes.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+
+    if (held) {
+        if (held < UINT16_MAX)
+            held++;
+
+        pinned_notes.store(pinned_notes.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_relaxed);
+        return base + route;
+    }
+
+    const uint32_t round = shared.load_round.load(std::memory_order_acquire);
+    if (round != seen_load_round) {
+        memset(routed_pending, 0, shared.num_instances * sizeof(uint32_t));
+        seen_load_round = round;
+    }
+
+    // Start from the fixed route, so it wins ties
+    uint32_t best = 0, best_load = UINT32_MAX, best_cost = UINT32_MAX;
+    for (uint32_t n = 0; n < kbdiv; n++) {
+        const uint32_t i = (key + n) % kbdiv;
+        const ThreadSharedInfo::InstanceLoad &load =
+            shared.instance_load[base + i];
+        const uint32_t voices = load.voices.load(std::memory_order_relaxed) +
+                                routed_pending[base + i];
+        const uint32_t cost = load.cost_us.load(std::memory_order_relaxed);
+
+        if (voices < best_load || (voices == best_load && cost < best_cost)) {
+            best = i;
+            best_load = voices;
+            best_cost = cost;
+        }
+    }
+
+    if (best != key % kbdiv)
+        rerouted_notes.store(
+            rerouted_notes.load(std::memory_order_relaxed) + 1,
+            std::memory_order_relaxed);
+
+    route = (uint8_t)best;
+    held = 1;
+    routed_pending[base + best]++;
+
+    return base + best;
+}
+
+uint32_t OmniMIDI::ThreadManager::RouteNoteOff(uint32_t channel,
+                                                   uint32_t key) {
+    if (key_held[channel][key])
+        key_held[channel][key]--;
+
+    return channel * kbdiv + key_route[channel][key];
+}
+
+void OmniMIDI::ThreadManager::GetRoutingStats(RoutingStats &stats) {
+    stats.notes = routed_notes.load(std::memory_order_relaxed);
+    stats.rerouted = rerouted_notes.load(std::memory_order_relaxed);
+    stats.pinned = pinned_notes.load(std::memory_order_relaxed);
+}
+
+// Average busy time per block of each thread since the last call, and how
+// close to perfectly spread the work was (100% means every thread was busy
+// for as long as the slowest one), plus how many instance-blocks were
+// skipped for being silent
+void OmniMIDI::ThreadManager::LogThreadStats() {
+    const uint64_t max_total = busy_max_total.load(std::memory_order_relaxed);
+    const uint64_t avg_total = busy_avg_total.load(std::memory_order_relaxed);
+    const uint64_t max_delta = max_total - last_max_total;
+    const uint64_t avg_delta = avg_total - last_avg_total;
+    const uint64_t rendered = rendered_total.load(std::memory_order_relaxed);
+    const uint64_t skipped = skipped_total.load(std::memory_order_relaxed);
+    const uint64_t rendered_delta = rendered - last_rendered_total;
+    const uint64_t skipped_delta = skipped - last_skipped_total;
+    const uint64_t dropped = dropped_long.load(std::memory_order_relaxed);
+    std::string line, routing, longev;
+
+    last_max_total = max_total;
+    last_avg_total = avg_total;
+    last_rendered_total = rendered;
+    last_skipped_total = skipped;
+
+    if (!max_delta && !skipped_delta)
+        return;
+
+    for (uint32_t i = 0; i < shared.num_threads; i++) {
+        const uint64_t total =
+            threads[i].busy_total.load(std::memory_order_relaxed);
+
+        line += " t" + std::to_string(i) + "=" +
+                std::to_string((total - last_busy_total[i]) / 1000);
+        last_busy_total[i] = total;
+    }
+
+    if (adaptive_routing) {
+        RoutingStats stats;
+        GetRoutingStats(stats);
+
+        routing = " rerouted=" +
+                  std::to_string(stats.rerouted - last_rerouted_notes) + "/" +
+                  std::to_string(stats.notes - last_routed_notes);
+        last_rerouted_notes = stats.rerouted;
+        last_routed_notes = stats.notes;
+    }
+
+    if (dropped != last_dropped_long) {
+        longev = " longev_dropped=" +
+                 std::to_string(dropped - last_dropped_long);
+        last_dropped_long = dropped;
+    }
+
+    Message("ThreadStats >> balance=%.1f%% skipped=%" PRIu64 "/%" PRIu64
+            " block=%zu ahead=%u%%%s%s busy_us:%s",
+            max_delta ? (double)avg_delta * 100.0 / (double)max_delta : 100.0,
+            skipped_delta, skipped_delta + rendered_delta,
+            buffered->render_size(), buffered->read_ahead(), routing.c_str(),
+            longev.c_str(), line.c_str());
+}
+
+void MixChunks(OmniMIDI::ThreadManager::ThreadSharedInfo *shared) {
+    using namespace OmniMIDI;
+
+    const size_t num_samples = shared->num_samples;
+
+    for (;;) {
+        const size_t offset =
+            (size_t)shared->cursor.fetch_add(1, std::memory_order_relaxed) *
+            MIXDOWN_CHUNK;
+        if (offset >= num_samples)
+            break;
+
+        Mixdown::Sum(shared->mix_out, shared->mix_srcs, shared->num_mix_srcs,
+                     offset,
+                     std::min((size_t)MIXDOWN_CHUNK, num_samples - offset));
+    }
+}
+
+void ThreadFunc(OmniMIDI::ThreadManager::ThreadInfo *info) {
+    using namespace OmniMIDI;
+
+    OmniMIDI::ThreadManager::ThreadSharedInfo *shared = info->shared;
+    uint32_t round = 0;
+
+    RTThread::Promote(shared->log, shared->rt, "Worker",
+                      (int32_t)info->thread_idx);
+
+    while (shared->barrier.WaitWork(round, info->spinner)) {
+        if (shared->mixing) {
+            MixChunks(shared);
+            shared->barrier.Arrive();
+            continue;
+        }
+
+        uint64_t thread_active_voices = 0;
+        uint64_t busy = 0;
+
+        for (;;) {
+            const uint32_t n =
+                shared->cursor.fetch_add(1, std::memory_order_relaxed);
+            if (n >= shared->num_instances)
+                break;
+            const uint32_t i = shared->instance_order[n];
+            RenderInstance *instance = shared->instances[i];
+
+            // Nothing to render, and its buffer stays out of the mixdown
+            shared->instance_skipped[i] = instance->IsIdle();
+            if (shared->instance_skipped[i]) {
+                shared->instance_cost[i] = 0;
+                shared->instance_load[i].voices.store(
+                    0, std::memory_order_relaxed);
+                shared->instance_load[i].cost_us.store(
+                    0, std::memory_order_relaxed);
+                continue;
+            }
+
+            const uint64_t start = EvBufTime();
+
+            memset(shared->instance_buffers[i], 0,
+                   shared->num_samples * sizeof(float));
+
+            if (shared->timed_events)
+                instance->RenderTimed(
+                    shared->instance_buffers[i], shared->num_samples,
+                    shared->audio_channels, shared->window_start,
+                    shared->window_len);
+            else
+                instance->Render(shared->instance_buffers[i],
+                                 shared->num_samples);
+
+            const uint64_t voices = instance->VoiceCount();
+            instance->TrackSilence(shared->instance_buffers[i],
+                                   shared->num_samples, voices);
+            thread_active_voices += voices;
+
+            shared->instance_cost[i] = EvBufTime() - start;
+            busy += shared->instance_cost[i];
+
+            shared->instance_load[i].voices.store(
+                (uint32_t)voices, std::memory_order_relaxed);
+            shared->instance_load[i].cost_us.store(
+                (uint32_t)(shared->instance_cost[i] / 1000),
+                std::memory_order_relaxed);
+        }
+
+        info->active_voices = thread_active_voices;
+        info->busy = busy;
+        info->busy_total.fetch_add(busy, std::memory_order_relaxed);
+        shared->barrier.Arrive();
+    }
+}
@@ -0,0 +1,237 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+#ifndef THREAD_MGR_H
+#define THREAD_MGR_H
+
+#include "../RTThread.hpp"
+#include "../WorkBarrier.hpp"
+#include "../audio/AudioPlayer.hpp"
+#include "../audio/BufferedRenderer.hpp"
+#include "../audio/Mixdown.hpp"
+#include "../audio/NpsLimiter.hpp"
+#include "RenderInstance.hpp"
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Long messages that can be in flight at once, a slot stays taken until
+// every instance it was sent to has played it
+#define THREADMGR_LONGEV_SLOTS 64
+// Bytes reserved up front for each slot, a bigger message grows it
+#define THREADMGR_LONGEV_RESERVE 256
+
+namespace OmniMIDI {
+// What the synth modules hand over to the ThreadManager, filled from
+// their own settings
+struct ThreadManagerConfig {
+    uint32_t SampleRate = 48000;
+    uint16_t AudioChannels = 2;
+
+    // Instances per MIDI channel, each one gets a slice of the keyboard
+    uint32_t KeyboardDivisions = 1;
+    // 0 means one per instance
+    uint32_t ThreadCount = 0;
+    // Frames rendered per block by the BufferedRenderer, and the bounds it
+    // can tune it within, see BufferedRenderer::AutoTune. It stays fixed
+    // unless MaxRenderSize is past MinRenderSize
+    size_t RenderSize = 480;
+    size_t MinRenderSize = 0;
+    size_t MaxRenderSize = 0;
+    uint32_t LatencyBias = 50;
+
+    uint64_t MaxInstanceNPS = 10000;
+    bool TimedEvents = false;
+    bool AdaptiveRouting = false;
+    bool AudioLimiter = false;
+
+    RTConfig RT;
+};
+
+// Splits the MIDI channels across KeyboardDivisions instances each, and
+// renders them in parallel on a pool of worker threads, no matter the
+// engine behind them. The synth module creates the instances through
+// the factory, one per (channel, division) pair.
+class ThreadManager {
+  public:
+    using InstanceFactory =
+        std::function<RenderInstance *(uint32_t channel, uint32_t division)>;
+
+    struct ThreadSharedInfo {
+        uint32_t num_threads;
+
+        RenderInstance **instances;
+        uint32_t num_instances;
+
+        NpsLimiter *nps = nullptr;
+
+        uint32_t num_samples;
+        float **instance_buffers;
+        float *instance_arena;
+
+        // Set by the workers for every instance they skipped this block,
+        // see RenderInstance::IsIdle()
+        uint8_t *instance_skipped;
+
+        // Set while the workers are summing mix_srcs into mix_out,
+        // MIXDOWN_CHUNK floats at a time, instead of rendering
+        bool mixing;
+        float *mix_out;
+        const float **mix_srcs;
+        uint32_t num_mix_srcs;
+
+        // Timed events, see RenderInstance::RenderTimed()
+        bool timed_events;
+        uint32_t audio_channels;
+        uint64_t window_start;
+        uint64_t window_len;
+
+        WorkBarrier barrier;
+
+        // Applied by every worker to itself when it starts
+        RTConfig rt;
+        ErrorSystem::Logger *log;
+
+        // Workers claim instances through the cursor, in the order given by
+        // instance_order: costliest first, based on the previous block.
+        // While mixing, it hands out chunks instead
+        alignas(WORKBARRIER_CACHELINE) std::atomic<uint32_t> cursor;
+        uint32_t *instance_order;
+        uint64_t *instance_cost;
+
+        // Published by the workers every block for the adaptive key
+        // routing, which runs on the events thread
+        struct InstanceLoad {
+            std::atomic<uint32_t> voices = 0;
+            std::atomic<uint32_t> cost_us = 0;
+        };
+        InstanceLoad *instance_load;
+        std::atomic<uint32_t> load_round;
+    };
+
+    struct RoutingStats {
+        uint64_t notes;    // Note ons routed
+        uint64_t rerouted; // Ones that didn't go to key % KeyboardDivisions
+        uint64_t pinned;   // Ones that followed a note still held on the key
+    };
+
+    // Each worker gets its own cache line
+    struct alignas(WORKBARRIER_CACHELINE) ThreadInfo {
+        std::jthread thread;
+        uint32_t thread_idx;
+
+        ThreadSharedInfo *shared;
+
+        uint64_t active_voices = 0;
+        WorkBarrier::Spinner spinner;
+
+        // Time spent rendering, in the last block and overall (ns)
+        uint64_t busy = 0;
+        std::atomic<uint64_t> busy_total = 0;
+    };
+
+    ThreadManager(ErrorSystem::Logger *PErr, const ThreadManagerConfig &cfg,
+                  InstanceFactory factory);
+    ~ThreadManager();
+    void SendEvent(uint32_t event, uint64_t stamp = 0);
+    void SendEvents(const uint32_t *events, const uint64_t *stamps,
+                    size_t count);
+    void SendLongEvent(const uint8_t *data, size_t len, uint64_t stamp = 0);
+    // A run of a synth module's short events, with the long messages
+    // queued in long_events through BaseEvBuf_t::WriteLinked() sent in
+    // place of their placeholders
+    void ForwardEvents(std::span<ShortEvent> evs, const uint64_t *stamps,
+                       BaseEvBuf_t *long_events);
+    void ReadSamples(float *buffer, size_t num_samples);
+    bool SetSoundFonts(const void *fonts, size_t count);
+    void ClearSoundFonts();
+
+    // See RenderInstance::SetSoundFonts() for what T has to be
+    template <typename T> bool SetSoundFonts(const std::vector<T> &sfs) {
+        return SetSoundFonts(sfs.data(), sfs.size());
+    }
+
+    uint64_t GetActiveVoices();
+    float GetRenderingTime();
+    void GetAudioStats(AudioMetrics &m);
+    void GetRoutingStats(RoutingStats &stats);
+    void LogThreadStats();
+
+  private:
+    ErrorSystem::Logger *ErrLog = nullptr;
+
+    uint32_t kbdiv;
+    uint32_t sample_rate;
+
+    // Adaptive key routing, only touched by the events thread.
+    // key_route remembers which instance of the channel got each key, so
+    // its note off and any overlapping note on follow it there.
+    bool adaptive_routing = false;
+    uint8_t key_route[16][128];
+    uint16_t key_held[16][128];
+    uint32_t *routed_pending = nullptr;
+    uint32_t seen_load_round = 0;
+
+    std::atomic<uint64_t> routed_notes = 0;
+    std::atomic<uint64_t> rerouted_notes = 0;
+    std::atomic<uint64_t> pinned_notes = 0;
+
+    uint32_t RouteNoteOn(uint32_t channel, uint32_t key);
+    uint32_t RouteNoteOff(uint32_t channel, uint32_t key);
+
+    // Long messages, stored once for all the instances they go to. Taken
+    // by the events thread, given back by the workers
+    LongEventSlot *long_slots = nullptr;
+    uint32_t long_next = 0;
+    std::atomic<uint64_t> dropped_long = 0;
+
+    ThreadInfo *threads;
+    ThreadSharedInfo shared;
+    WorkBarrier::Spinner spinner;
+
+    // Sum of the busiest thread's time and of the average thread's time
+    // across all blocks, their ratio is how well the work was spread
+    std::atomic<uint64_t> busy_max_total = 0;
+    std::atomic<uint64_t> busy_avg_total = 0;
+
+    // Instance-blocks rendered and skipped for being silent
+    std::atomic<uint64_t> rendered_total = 0;
+    std::atomic<uint64_t> skipped_total = 0;
+
+    // LogThreadStats() state
+    uint64_t *last_busy_total = nullptr;
+    uint64_t last_max_total = 0;
+    uint64_t last_avg_total = 0;
+    uint64_t last_rendered_total = 0;
+    uint64_t last_skipped_total = 0;
+    uint64_t last_routed_notes = 0;
+    uint64_t last_rerouted_notes = 0;
+    uint64_t last_dropped_long = 0;
+
+    BufferedRenderer *buffered = nullptr;
+
+    // Written by the render thread, read by the synth module's
+    std::atomic<uint64_t> ActiveVoices = 0;
+
+    MIDIAudioPlayer *audio_player = nullptr;
+};
+} // namespace OmniMIDI
+
+#endif
\ No newline at end of file
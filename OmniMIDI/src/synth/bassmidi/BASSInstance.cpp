@@ -21,17 +21,23 @@
 #include "bass/bass_fx.h"
 #include "bass/bassmidi.h"
 #include <cstdint>
+#include <cstring>
 
 OmniMIDI::BASSInstance::BASSInstance(ErrorSystem::Logger *pErr,
                                      BASSSettings *bassConfig,
-                                     uint32_t channels) {
+                                     uint32_t channels)
+    : RenderInstance(pErr, bassConfig->SampleRate,
+                     bassConfig->MonoRendering ? 1 : 2,
+                     bassConfig->Threading == Multithreaded
+                         ? bassConfig->InstanceEvBufSize
+                         : bassConfig->GlobalEvBufSize,
+                     bassConfig->Threading == Multithreaded &&
+                         bassConfig->TimedEvents) {
     bool mtMode = bassConfig->Threading == Multithreaded;
 
-    ErrLog = pErr;
     num_channels = channels;
     audioLimiter = 0;
-    evbuf_len = 0;
-    evbuf_capacity =
+    size_t evbuf_capacity =
         mtMode ? bassConfig->InstanceEvBufSize : bassConfig->GlobalEvBufSize;
 
     bool decodeMode = mtMode || bassConfig->AudioEngine != Internal;
@@ -50,12 +56,6 @@ OmniMIDI::BASSInstance::BASSInstance(ErrorSystem::Logger *pErr,
         throw BASS_ErrorGetCode();
     }
 
-    evbuf = new uint32_t[evbuf_capacity]{};
-    if (!evbuf) {
-        BASS_StreamFree(stream);
-        throw std::runtime_error("");
-    }
-
     BASS_ChannelSetAttribute(stream, BASS_ATTRIB_BUFFER, 0);
     BASS_ChannelSetAttribute(stream, BASS_ATTRIB_MIDI_VOICES,
                              (float)bassConfig->VoiceLimit);
@@ -101,25 +101,31 @@ OmniMIDI::BASSInstance::BASSInstance(ErrorSystem::Logger *pErr,
 }
 
 OmniMIDI::BASSInstance::~BASSInstance() {
-    delete[] evbuf;
-
     BASS_ChannelStop(stream);
     BASS_StreamFree(stream);
 }
 
-void OmniMIDI::BASSInstance::SendEvent(uint32_t event) {
-    std::unique_lock<std::mutex> lck(evbuf_mutex);
+// Hands a whole run of events to BASSMIDI in one go, without going through
+// the queue. Whatever is still queued gets flushed first to keep the
+// events in order.
+void OmniMIDI::BASSInstance::SendEvents(const uint32_t *events, size_t count) {
+    FlushEvents();
 
-    if (evbuf_len == evbuf_capacity) {
-        lck.unlock();
-        FlushEvents();
-    }
+    BASS_MIDI_StreamEvents(stream,
+                           BASS_MIDI_EVENTS_RAW | BASS_MIDI_EVENTS_NORSTATUS,
+                           (void *)events, count * sizeof(uint32_t));
+    MarkPending();
+}
 
-    evbuf[evbuf_len++] = event;
+void OmniMIDI::BASSInstance::SendLongEvent(const uint8_t *data, size_t len) {
+    FlushEvents();
+    PlayLongEvent(data, len);
+    MarkPending();
 }
 
 bool OmniMIDI::BASSInstance::SendDirectEvent(uint32_t chan, uint32_t evt,
                                              uint32_t param) {
+    MarkPending();
     return BASS_MIDI_StreamEvent(stream, chan, evt, param);
 }
 
@@ -134,7 +140,12 @@ int OmniMIDI::BASSInstance::ReadData(void *buffer, size_t size) {
     return BASS_ChannelGetData(stream, buffer, size);
 }
 
-uint64_t OmniMIDI::BASSInstance::GetActiveVoices() {
+int OmniMIDI::BASSInstance::RenderSamples(float *buffer, size_t count) {
+    int res = BASS_ChannelGetData(stream, buffer, count * sizeof(float));
+    return res > 0 ? res / (int)sizeof(float) : 0;
+}
+
+uint64_t OmniMIDI::BASSInstance::VoiceCount() {
     uint64_t val = 0;
     for (uint32_t i = 0; i < num_channels; i++) {
         int res = BASS_MIDI_StreamGetEvent(stream, i, MIDI_EVENT_VOICES);
@@ -150,17 +161,16 @@ float OmniMIDI::BASSInstance::GetRenderingTime() {
     return val;
 }
 
-int OmniMIDI::BASSInstance::SetSoundFonts(
-    const std::vector<BASS_MIDI_FONTEX> &sfs) {
-    return BASS_MIDI_StreamSetFonts(stream, sfs.data(),
-                                    (uint32_t)sfs.size() | BASS_MIDI_FONT_EX);
+bool OmniMIDI::BASSInstance::SetSoundFonts(const void *fonts, size_t count) {
+    return BASS_MIDI_StreamSetFonts(stream, fonts,
+                                    (uint32_t)count | BASS_MIDI_FONT_EX);
 }
 
 void OmniMIDI::BASSInstance::SetDrums(bool isDrumsChan) {
     BASS_MIDI_StreamEvent(stream, 0, MIDI_EVENT_DEFDRUMS, (float)isDrumsChan);
 }
 
-void OmniMIDI::BASSInstance::ResetStream(uint8_t type) {
+void OmniMIDI::BASSInstance::PlayReset(uint8_t type) {
     uint32_t bmType = 0;
 
     switch (type) {
@@ -185,21 +195,18 @@ void OmniMIDI::BASSInstance::ResetStream(uint8_t type) {
         break;
     }
 
-    {
-        std::unique_lock<std::mutex> lck(evbuf_mutex);
-        evbuf_len = 0;
-    }
-
     BASS_MIDI_StreamEvent(stream, 0, MIDI_EVENT_SYSTEMEX, bmType);
 }
 
-void OmniMIDI::BASSInstance::FlushEvents() {
-    std::unique_lock<std::mutex> lck(evbuf_mutex);
+void OmniMIDI::BASSInstance::PlayLongEvent(const uint8_t *data,
+                                           size_t len) {
+    BASS_MIDI_StreamEvents(stream, BASS_MIDI_EVENTS_RAW, (void *)data, len);
+}
 
+void OmniMIDI::BASSInstance::PlayEvents(const uint32_t *events,
+                                        size_t count) {
     BASS_MIDI_StreamEvents(stream,
                            BASS_MIDI_EVENTS_RAW | BASS_MIDI_EVENTS_NORSTATUS,
-                           evbuf, evbuf_len * sizeof(uint32_t));
-
-    evbuf_len = 0;
+                           (void *)events, count * sizeof(uint32_t));
 }
-#endif
\ No newline at end of file
+#endif
@@ -19,46 +19,43 @@
 
 #ifdef _NONFREE
 
+#include "../RenderInstance.hpp"
 #include "BASSSettings.hpp"
 #include "bass/bass.h"
 #include "bass/bassmidi.h"
-#include <mutex>
-#include <vector>
 
 namespace OmniMIDI {
-class BASSInstance {
+class BASSInstance final : public RenderInstance {
   public:
     BASSInstance(ErrorSystem::Logger *pErr, BASSSettings *bassConfig,
                  uint32_t channels);
     ~BASSInstance();
 
-    void SendEvent(uint32_t event);
+    // Unlike SendEvent() and ResetStream(), these flush the queue and go
+    // straight to BASSMIDI, they have to come from the thread that renders
+    void SendEvents(const uint32_t *events, size_t count);
+    void SendLongEvent(const uint8_t *data, size_t len);
     bool SendDirectEvent(uint32_t chan, uint32_t evt, uint32_t param);
-    void FlushEvents();
-    void FlushEventBuffer();
 
     uint32_t GetHandle();
     void UpdateStream(uint32_t ms);
     int ReadData(void *buffer, size_t size);
 
-    uint64_t GetActiveVoices();
+    uint64_t VoiceCount() override;
     float GetRenderingTime();
 
-    int SetSoundFonts(const std::vector<BASS_MIDI_FONTEX> &sfs);
+    bool SetSoundFonts(const void *fonts, size_t count) override;
     void SetDrums(bool isDrumsChan);
-    void ResetStream(uint8_t bmType);
+
+  protected:
+    void PlayEvents(const uint32_t *events, size_t count) override;
+    void PlayReset(uint8_t type) override;
+    void PlayLongEvent(const uint8_t *data, size_t len) override;
+    int RenderSamples(float *buffer, size_t count) override;
 
   private:
     uint32_t num_channels;
 
-    ErrorSystem::Logger *ErrLog = nullptr;
-
-    uint32_t *evbuf;
-    uint32_t evbuf_len;
-    uint32_t evbuf_capacity;
-
-    std::mutex evbuf_mutex;
-
     HSTREAM stream;
     HFX audioLimiter;
 };
@@ -31,6 +31,12 @@ void OmniMIDI::BASSSettings::RewriteSynthConfig() {
         ConfGetVal(RenderTimeLimit),   ConfGetVal(VoiceLimit),
         ConfGetVal(AudioBuf),          ConfGetVal(ThreadCount),
         ConfGetVal(MaxInstanceNPS),    ConfGetVal(InstanceEvBufSize),
+        ConfGetVal(TimedEvents),       ConfGetVal(EvBufOverflowPolicy),
+        ConfGetVal(CoalesceEvents),    ConfGetVal(KeyRouting),
+        ConfGetVal(RTPolicy),          ConfGetVal(RTPriority),
+        ConfGetVal(RTAffinity),        ConfGetVal(LockMemory),
+        ConfGetVal(MinAudioBuf),       ConfGetVal(MaxAudioBuf),
+        ConfGetVal(LatencyBias),
 
 #if !defined(_WIN32)
         ConfGetVal(BufPeriod),
@@ -66,6 +72,17 @@ void OmniMIDI::BASSSettings::LoadSynthConfig() {
         SynthSetVal(uint32_t, ThreadCount);
         SynthSetVal(uint32_t, MaxInstanceNPS);
         SynthSetVal(uint64_t, InstanceEvBufSize);
+        SynthSetVal(bool, TimedEvents);
+        SynthSetVal(uint32_t, EvBufOverflowPolicy);
+        SynthSetVal(bool, CoalesceEvents);
+        SynthSetVal(uint32_t, KeyRouting);
+        SynthSetVal(uint32_t, RTPolicy);
+        SynthSetVal(int32_t, RTPriority);
+        SynthSetVal(std::string, RTAffinity);
+        SynthSetVal(bool, LockMemory);
+        SynthSetVal(float, MinAudioBuf);
+        SynthSetVal(float, MaxAudioBuf);
+        SynthSetVal(uint32_t, LatencyBias);
 
 #if !defined(_WIN32)
         SynthSetVal(uint32_t, BufPeriod);
@@ -90,6 +107,21 @@ void OmniMIDI::BASSSettings::LoadSynthConfig() {
         if (KeyboardDivisions > 128)
             KeyboardDivisions = 128;
 
+        if (EvBufOverflowPolicy > OVERFLOW_COUNT)
+            EvBufOverflowPolicy = OverflowDrop;
+
+        if (KeyRouting > KEYROUTING_COUNT)
+            KeyRouting = RouteFixed;
+
+        if (MinAudioBuf <= 0.0f || MinAudioBuf > AudioBuf)
+            MinAudioBuf = AudioBuf;
+
+        if (MaxAudioBuf < AudioBuf || MaxAudioBuf > 1000.0f)
+            MaxAudioBuf = AudioBuf;
+
+        if (LatencyBias > 100)
+            LatencyBias = 50;
+
 #if !defined(_WIN32)
         if (BufPeriod < 0 || BufPeriod > 4096)
             BufPeriod = 480;
@@ -47,6 +47,14 @@ enum BASSMultithreadingType {
     Multithreaded = 2
 };
 
+// How the multithreaded mode picks which of a channel's KeyboardDivisions
+// instances plays a note
+enum BASSKeyRouting {
+    RouteFixed = 0,    // key % KeyboardDivisions
+    RouteAdaptive = 1, // least loaded instance, see ThreadManager
+    KEYROUTING_COUNT = RouteAdaptive
+};
+
 class BASSSettings : public SettingsModule {
   public:
     uint64_t GlobalEvBufSize = 65536;
@@ -63,10 +71,22 @@ class BASSSettings : public SettingsModule {
     uint32_t ThreadCount = 0;
     uint64_t MaxInstanceNPS = 10000;
     uint64_t InstanceEvBufSize = 8192;
+    bool TimedEvents = true;
+    uint32_t EvBufOverflowPolicy = OverflowDrop;
+    bool CoalesceEvents = false;
+    uint32_t KeyRouting = RouteFixed;
 
     int32_t AudioEngine = (int)DEFAULT_ENGINE;
     float AudioBuf = 10.0f;
 
+    // Bounds the multithreaded mode tunes AudioBuf within (ms), from its
+    // load and the underruns, see BufferedRenderer::AutoTune. It starts
+    // from AudioBuf, and doesn't tune anything if MaxAudioBuf isn't past
+    // MinAudioBuf. LatencyBias goes from 0 (latency) to 100 (safety)
+    float MinAudioBuf = 10.0f;
+    float MaxAudioBuf = 40.0f;
+    uint32_t LatencyBias = 50;
+
 #if !defined(_WIN32)
     uint32_t BufPeriod = 480;
 #else
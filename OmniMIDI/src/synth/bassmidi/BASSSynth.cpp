@@ -29,7 +29,8 @@
 #include "BASSSynth.hpp"
 #include <exception>
 
-OmniMIDI::BASSSynth::BASSSynth(ErrorSystem::Logger *PErr) : SynthModule(PErr) {
+OmniMIDI::BASSSynth::BASSSynth(ErrorSystem::Logger *PErr)
+    : BufferedSynthModule(PErr) {
     _sfSystem = new SoundFontSystem(PErr);
 }
 
@@ -45,14 +46,7 @@ DWORD CALLBACK OmniMIDI::BASSSynth::AudioProcesser(void *buffer, DWORD length,
 
 DWORD CALLBACK OmniMIDI::BASSSynth::AudioEvProcesser(void *buffer, DWORD length,
                                                      BASSSynth *me) {
-    BASSInstance *bass = me->standard_instance;
-    BaseEvBuf_t *evbuf = me->ShortEvents;
-
-    do
-        bass->SendEvent(evbuf->Read());
-    while (evbuf->NewEventsAvailable());
-    bass->FlushEvents();
-
+    me->DrainShortEvents();
     return AudioProcesser(buffer, length, me);
 }
 
@@ -180,6 +174,45 @@ bool OmniMIDI::BASSSynth::ClearFuncs() {
     return true;
 }
 
+// Hands every contiguous run of queued events straight to the stream,
+// without copying them into the instance's own buffer first. Long messages
+// are sent in place of their placeholders, the same way
+// ThreadManager::ForwardEvents() does, so a reset can't wipe out the events
+// the app sent right after it.
+void OmniMIDI::BASSSynth::DrainShortEvents() {
+    for (auto evs = ShortEvents->AcquireReadable(); !evs.empty();
+         evs = ShortEvents->AcquireReadable()) {
+        size_t start = 0;
+
+        if (coalescer)
+            coalescer->Process(evs);
+
+        for (size_t i = 0; i < evs.size(); i++) {
+            if ((evs[i] & 0xFF) != SystemMessageStart)
+                continue;
+
+            if (i > start)
+                standard_instance->SendEvents(evs.data() + start, i - start);
+            start = i + 1;
+
+            auto lev = LongEvents->AcquireLinked(evs[i]);
+            if (lev.empty())
+                continue;
+
+            standard_instance->SendLongEvent(lev.data(), lev.size());
+            LongEvents->ReleaseLinked(evs[i]);
+        }
+
+        if (evs.size() > start)
+            standard_instance->SendEvents(evs.data() + start,
+                                          evs.size() - start);
+
+        ShortEvents->Release(evs.size());
+    }
+
+    standard_instance->FlushEvents();
+}
+
 void OmniMIDI::BASSSynth::RenderingThread() {
     int32_t sleepRate = -1;
     uint32_t updRate = 1;
@@ -200,11 +233,7 @@ void OmniMIDI::BASSSynth::RenderingThread() {
     switch (_bassConfig->Threading) {
     case SingleThread:
         while (IsSynthInitialized()) {
-            do
-                standard_instance->SendEvent(ShortEvents->Read());
-            while (ShortEvents->NewEventsAvailable());
-
-            standard_instance->FlushEvents();
+            DrainShortEvents();
             standard_instance->UpdateStream(updRate);
             Utils.MicroSleep(sleepRate);
         }
@@ -232,20 +261,22 @@ void OmniMIDI::BASSSynth::ProcessingThread() {
     switch (_bassConfig->Threading) {
     case Standard:
         while (IsSynthInitialized()) {
-            do
-                standard_instance->SendEvent(ShortEvents->Read());
-            while (ShortEvents->NewEventsAvailable());
-
-            standard_instance->FlushEvents();
+            DrainShortEvents();
             Utils.MicroSleep(SLEEPVAL(1));
         }
         break;
 
     case Multithreaded:
         while (IsSynthInitialized()) {
-            do
-                thread_mgr->SendEvent(ShortEvents->Read());
-            while (ShortEvents->NewEventsAvailable());
+            for (auto evs = ShortEvents->AcquireReadable(); !evs.empty();
+                 evs = ShortEvents->AcquireReadable()) {
+                if (coalescer)
+                    coalescer->Process(evs);
+
+                thread_mgr->ForwardEvents(evs, ShortEvents->ReadableStamps(),
+                                          LongEvents);
+                ShortEvents->Release(evs.size());
+            }
 
             Utils.MicroSleep(SLEEPVAL(1));
         }
@@ -256,6 +287,16 @@ void OmniMIDI::BASSSynth::ProcessingThread() {
     }
 }
 
+void OmniMIDI::BASSSynth::GetEventStats(EvBufMetrics &m) {
+    SynthModule::GetEventStats(m);
+
+    if (coalescer) {
+        auto &stats = coalescer->GetStats();
+        m.Coalesced = stats.ControlChanges.load() + stats.PitchBends.load() +
+                      stats.ChannelPressure.load();
+    }
+}
+
 void OmniMIDI::BASSSynth::StatsThread() {
     // Spin while waiting for the stream to go online
     while (!isActive)
@@ -268,7 +309,8 @@ void OmniMIDI::BASSSynth::StatsThread() {
     case Standard: {
         while (IsSynthInitialized()) {
             RenderingTime = standard_instance->GetRenderingTime();
-            ActiveVoices = standard_instance->GetActiveVoices();
+            ActiveVoices = standard_instance->VoiceCount();
+            LogEventStats();
 
             Utils.MicroSleep(SLEEPVAL(100000));
         }
@@ -279,6 +321,8 @@ void OmniMIDI::BASSSynth::StatsThread() {
         while (IsSynthInitialized()) {
             RenderingTime = thread_mgr->GetRenderingTime();
             ActiveVoices = thread_mgr->GetActiveVoices();
+            if (LogEventStats())
+                thread_mgr->LogThreadStats();
 
             Utils.MicroSleep(SLEEPVAL(100000));
         }
@@ -308,6 +352,29 @@ bool OmniMIDI::BASSSynth::LoadSynthModule() {
                 _bassConfig->GlobalEvBufSize);
     }
 
+    Events->SetOverflowPolicy((EvBufOverflow)_bassConfig->EvBufOverflowPolicy);
+
+    // The multithreaded renderer places events within the block
+    // based on when they were captured
+    if (_bassConfig->Threading == Multithreaded && _bassConfig->TimedEvents) {
+        if (!Events->EnableTimestamps()) {
+            Error("Failed to allocate the timestamps buffer, events will be "
+                  "applied at the start of each block.",
+                  false);
+            _bassConfig->TimedEvents = false;
+        }
+    }
+
+    if (!AllocateLongEvBuf(DEF_LEVBUF_SIZE)) {
+        Error("AllocateLongEvBuf failed.", true);
+        return false;
+    }
+
+    if (_bassConfig->CoalesceEvents) {
+        coalescer = new EventCoalescer;
+        Message("Event coalescing enabled.");
+    }
+
     return true;
 }
 
@@ -315,7 +382,21 @@ bool OmniMIDI::BASSSynth::UnloadSynthModule() {
     if (ClearFuncs()) {
         SoundFonts.clear();
 
+        LogEventStats(true);
+
+        if (coalescer) {
+            auto &stats = coalescer->GetStats();
+            Message("Coalesced events >> CC: %zu, Pitch bend: %zu, Channel "
+                    "pressure: %zu",
+                    stats.ControlChanges.load(), stats.PitchBends.load(),
+                    stats.ChannelPressure.load());
+
+            delete coalescer;
+            coalescer = nullptr;
+        }
+
         FreeShortEvBuf();
+        FreeLongEvBuf();
         FreeSynthConfig(_bassConfig);
 
         return true;
@@ -329,7 +410,7 @@ void OmniMIDI::BASSSynth::LoadSoundFonts() {
     switch (_bassConfig->Threading) {
     case SingleThread:
     case Standard: {
-        standard_instance->SetSoundFonts(std::vector<BASS_MIDI_FONTEX>());
+        standard_instance->SetSoundFonts(nullptr, 0);
         break;
     }
 
@@ -404,13 +485,16 @@ void OmniMIDI::BASSSynth::LoadSoundFonts() {
     switch (_bassConfig->Threading) {
     case SingleThread:
     case Standard:
-        if (!standard_instance->SetSoundFonts(SoundFonts)) {
+        if (!standard_instance->SetSoundFonts(SoundFonts.data(),
+                                              SoundFonts.size())) {
             err = BASS_ErrorGetCode();
         }
         break;
 
     case Multithreaded:
-        err = thread_mgr->SetSoundFonts(SoundFonts);
+        if (!thread_mgr->SetSoundFonts(SoundFonts)) {
+            err = BASS_ErrorGetCode();
+        }
         break;
     }
 
@@ -688,10 +772,49 @@ bool OmniMIDI::BASSSynth::StartSynthModule() {
     }
 
     case Multithreaded: {
+        // The streams only decode, the ThreadManager plays them through
+        // its own audio player
+        if (!BASS_Init(0, _bassConfig->SampleRate, 0, NULL, NULL)) {
+            Error("BASS_Init failed with error 0x%x.", true,
+                  BASS_ErrorGetCode());
+            return false;
+        }
+
+        ThreadManagerConfig cfg;
+        cfg.SampleRate = _bassConfig->SampleRate;
+        cfg.AudioChannels = _bassConfig->MonoRendering ? 1 : 2;
+        cfg.KeyboardDivisions = _bassConfig->KeyboardDivisions;
+        cfg.ThreadCount = _bassConfig->ThreadCount;
+        cfg.RenderSize = (size_t)std::max(
+            (float)_bassConfig->SampleRate * _bassConfig->AudioBuf / 1000.0f,
+            1.0f);
+        cfg.MinRenderSize = (size_t)std::max(
+            (float)_bassConfig->SampleRate * _bassConfig->MinAudioBuf /
+                1000.0f,
+            1.0f);
+        cfg.MaxRenderSize = (size_t)std::max(
+            (float)_bassConfig->SampleRate * _bassConfig->MaxAudioBuf /
+                1000.0f,
+            1.0f);
+        cfg.LatencyBias = _bassConfig->LatencyBias;
+        cfg.MaxInstanceNPS = _bassConfig->MaxInstanceNPS;
+        cfg.TimedEvents = _bassConfig->TimedEvents;
+        cfg.AdaptiveRouting = _bassConfig->KeyRouting == RouteAdaptive;
+        cfg.AudioLimiter = _bassConfig->AudioLimiter;
+        cfg.RT = _bassConfig->GetRTConfig();
+
+        auto factory = [this](uint32_t channel,
+                              uint32_t division) -> RenderInstance * {
+            BASSInstance *instance = new BASSInstance(ErrLog, _bassConfig, 1);
+            instance->SetDrums(channel == 9);
+            return instance;
+        };
+
         try {
-            thread_mgr = new BASSThreadManager(ErrLog, _bassConfig);
+            thread_mgr = new ThreadManager(ErrLog, cfg, factory);
         } catch (const std::exception &e) {
-            Error("BASSThreadManager intialization failed: %s", true, e.what());
+            Error("ThreadManager intialization failed: %s", true, e.what());
+            BASS_Free();
             return false;
         }
         break;
@@ -706,10 +829,9 @@ bool OmniMIDI::BASSSynth::StartSynthModule() {
         Error("_EvtThread failed. (ID: %x)", true, _EvtThread.get_id());
         if (thread_mgr)
             delete thread_mgr;
-        if (standard_instance) {
+        if (standard_instance)
             delete standard_instance;
-            BASS_Free();
-        }
+        BASS_Free();
         return false;
     }
     Message("Processing thread started.");
@@ -719,15 +841,16 @@ bool OmniMIDI::BASSSynth::StartSynthModule() {
         Error("_StatsThread failed. (ID: %x)", true, _StatsThread.get_id());
         if (thread_mgr)
             delete thread_mgr;
-        if (standard_instance) {
+        if (standard_instance)
             delete standard_instance;
-            BASS_Free();
-        }
+        BASS_Free();
         return false;
     }
     Message("Stats thread started.");
 
+    // The long messages go too, their placeholders are gone
     ShortEvents->ResetHeads();
+    LongEvents->ResetHeads();
     StartDebugOutput();
 
     isActive = true;
@@ -787,6 +910,7 @@ bool OmniMIDI::BASSSynth::StopSynthModule() {
 
     case Multithreaded:
         delete thread_mgr;
+        BASS_Free();
         Message("Deleted BASSMIDI thread manager.");
         break;
     }
@@ -848,6 +972,28 @@ bool OmniMIDI::BASSSynth::SettingsManager(uint32_t setting, bool get, void *var,
         SettingsManagerCase(KDMAPI_MAXRENDERINGTIME, get, uint32_t,
                             _bassConfig->RenderTimeLimit, var, size);
 
+    // Kept for compatibility, maps to the blocking overflow policy
+    case KDMAPI_DONTMISSNOTES: {
+        if (size != sizeof(uint32_t))
+            return false;
+
+        if (get) {
+            *(uint32_t *)var =
+                _bassConfig->EvBufOverflowPolicy == OverflowBlock;
+            break;
+        }
+
+        _bassConfig->EvBufOverflowPolicy =
+            *(uint32_t *)var ? OverflowBlock : OverflowDrop;
+
+        // The ring only reads the setting when it's loaded
+        if (Events)
+            Events->SetOverflowPolicy(
+                (EvBufOverflow)_bassConfig->EvBufOverflowPolicy);
+
+        break;
+    }
+
     default:
         Message("Unknown setting passed to SettingsManager. (VAL: 0x%x)",
                 setting);
@@ -869,31 +1015,15 @@ uint32_t OmniMIDI::BASSSynth::PlayLongEvent(uint8_t *ev, uint32_t size) {
 }
 
 uint32_t OmniMIDI::BASSSynth::UPlayLongEvent(uint8_t *ev, uint32_t size) {
-    // Converting the byte array to uint array is supported since it will be
-    // deconstructed again when sending to BASSMIDI. This is not supported for
-    // multithreading since we have to process each event before BASSMIDI.
-
-    if (_bassConfig->Threading == Multithreaded)
-        return 0;
-
-    uint32_t out_events = (size + 3) / 4;
-    uint32_t curr_evt = 0;
-
-    for (uint32_t i = 0; i < out_events; i++) {
-        for (uint32_t k = 0; k < 4; k++) {
-            size_t current_index = i * 4 + k;
-            if (current_index < size) {
-                curr_evt |= (uint32_t)(ev[current_index]) << (24 - i * 8);
-            } else {
-                // Pad with 0s if we've reached the end of the input array
-                curr_evt |= 0x00 << (24 - i * 8);
-            }
-        }
-
-        ShortEvents->Write(curr_evt);
-    }
-
-    return out_events;
+    // The message is queued as is, and handed to BASSMIDI as raw data by the
+    // thread that drains the short events.
+    // It has to get there in order with the short events, so it gets a
+    // placeholder in their queue that tells where to find it, see
+    // DrainShortEvents() and ThreadManager::ForwardEvents(). Nothing is
+    // queued if either ring is full.
+    return LongEvents->WriteLinked(ev, size, ShortEvents, SystemMessageStart)
+               ? size
+               : 0;
 }
 
 OmniMIDI::SynthResult OmniMIDI::BASSSynth::TalkToSynthDirectly(uint32_t evt,
@@ -22,6 +22,7 @@
 #ifndef _BASSSYNTH_H
 #define _BASSSYNTH_H
 
+#include "../EventCoalescer.hpp"
 #include "../SynthModule.hpp"
 #include <atomic>
 #include <unordered_map>
@@ -29,7 +30,8 @@
 #include "bass/bass.h"
 #include "bass/bassmidi.h"
 
-#include "BASSThreadMgr.hpp"
+#include "../ThreadMgr.hpp"
+#include "BASSInstance.hpp"
 
 #define BASE_IMPORTS 38
 
@@ -58,7 +60,7 @@
 
 namespace OmniMIDI {
 
-class BASSSynth : public SynthModule {
+class BASSSynth final : public BufferedSynthModule<LanedEvBuf> {
   private:
     struct RealtimeStatistics {
         std::shared_ptr<std::atomic<uint64_t>> VoiceCount;
@@ -161,6 +163,7 @@ class BASSSynth : public SynthModule {
     void RenderingThread();
     void ProcessingThread();
     void StatsThread();
+    void DrainShortEvents();
 
     bool isActive = false;
 
@@ -168,8 +171,9 @@ class BASSSynth : public SynthModule {
     SoundFontSystem *_sfSystem = nullptr;
     std::vector<BASS_MIDI_FONTEX> SoundFonts;
 
-    BASSThreadManager *thread_mgr = nullptr;
+    ThreadManager *thread_mgr = nullptr;
     BASSInstance *standard_instance = nullptr;
+    EventCoalescer *coalescer = nullptr;
 
     std::jthread _StatsThread;
 
@@ -191,6 +195,14 @@ class BASSSynth : public SynthModule {
 
     uint32_t SynthID() override { return 0x1411BA55; }
 
+    void GetEventStats(EvBufMetrics &m) override;
+    void GetAudioStats(AudioMetrics &m) override {
+        if (thread_mgr)
+            thread_mgr->GetAudioStats(m);
+        else
+            m = {};
+    }
+
     uint32_t PlayLongEvent(uint8_t *ev, uint32_t size) override;
     uint32_t UPlayLongEvent(uint8_t *ev, uint32_t size) override;
 
@@ -0,0 +1,142 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+#include "FluidInstance.hpp"
+#include <stdexcept>
+
+OmniMIDI::FluidInstance::FluidInstance(ErrorSystem::Logger *pErr,
+                                       fluid_settings_t *settings,
+                                       uint8_t channel, uint32_t sampleRate,
+                                       size_t evbufCapacity)
+    : RenderInstance(pErr, sampleRate, 2, evbufCapacity, false) {
+    this->channel = channel;
+
+    synth = new_fluid_synth(settings);
+    if (!synth)
+        throw std::runtime_error("new_fluid_synth failed!");
+}
+
+OmniMIDI::FluidInstance::~FluidInstance() {
+    if (synth)
+        delete_fluid_synth(synth);
+}
+
+uint64_t OmniMIDI::FluidInstance::VoiceCount() {
+    int voices = fluid_synth_get_active_voice_count(synth);
+    return voices > 0 ? (uint64_t)voices : 0;
+}
+
+// fonts is an array of paths, FluidSynth can't share a loaded soundfont
+// between synths so every instance loads its own copy
+bool OmniMIDI::FluidInstance::SetSoundFonts(const void *fonts, size_t count) {
+    const char *const *paths = (const char *const *)fonts;
+    bool ok = true;
+
+    for (int id : sfids)
+        fluid_synth_sfunload(synth, id, 0);
+    sfids.clear();
+
+    for (size_t i = 0; i < count; i++) {
+        int id = fluid_synth_sfload(synth, paths[i], i == count - 1);
+        if (id < 0) {
+            Error("fluid_synth_sfload failed to load \"%s\"!", false,
+                  paths[i]);
+            ok = false;
+            continue;
+        }
+
+        sfids.push_back(id);
+    }
+
+    MarkPending();
+    return ok;
+}
+
+// Anything that isn't a channel message is left out, the ThreadManager
+// sends the system ones as resets or long messages
+void OmniMIDI::FluidInstance::PlayEvents(const uint32_t *events,
+                                         size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint8_t status = MIDIUtils::GetStatus(events[i]);
+        uint8_t param1 = MIDIUtils::GetFirstParam(events[i]);
+        uint8_t param2 = MIDIUtils::GetSecondParam(events[i]);
+
+        switch (MIDIUtils::GetCommand(status)) {
+        case NoteOn:
+            // param1 is the key, param2 is the velocity
+            fluid_synth_noteon(synth, channel, param1, param2);
+            break;
+
+        case NoteOff:
+            fluid_synth_noteoff(synth, channel, param1);
+            break;
+
+        case Aftertouch:
+            fluid_synth_key_pressure(synth, channel, param1, param2);
+            break;
+
+        case CC:
+            fluid_synth_cc(synth, channel, param1, param2);
+            break;
+
+        case PatchChange:
+            fluid_synth_program_change(synth, channel, param1);
+            break;
+
+        case ChannelPressure:
+            fluid_synth_channel_pressure(synth, channel, param1);
+            break;
+
+        case PitchBend:
+            fluid_synth_pitch_bend(synth, channel,
+                                   MIDIUtils::MakeFullParam(param1, param2, 7));
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+void OmniMIDI::FluidInstance::PlayReset(uint8_t type) {
+    fluid_synth_all_sounds_off(synth, channel);
+    fluid_synth_system_reset(synth);
+}
+
+// The ThreadManager already pointed the part parameters at this instance's
+// channel, see PartChannel()
+void OmniMIDI::FluidInstance::PlayLongEvent(const uint8_t *data, size_t len) {
+    int resp_len = 0;
+
+    // Ignore 0xF0 and 0xF7
+    fluid_synth_sysex(synth, (const char *)(data + 1), (int)len - 2, 0,
+                      &resp_len, 0, 0);
+}
+
+int OmniMIDI::FluidInstance::RenderSamples(float *buffer, size_t count) {
+    const int frames = (int)(count / 2);
+
+    // Interleaved, left on the even samples and right on the odd ones
+    int res =
+        fluid_synth_write_float(synth, frames, buffer, 0, 2, buffer, 1, 2);
+    if (res < 0)
+        return 0;
+
+    return frames * 2;
+}
@@ -0,0 +1,54 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+#ifndef _FLUIDINSTANCE_H
+#define _FLUIDINSTANCE_H
+
+#include "../RenderInstance.hpp"
+#include "fluidsynth.h"
+#include <vector>
+
+namespace OmniMIDI {
+// A FluidSynth synth with no audio driver, rendered by the ThreadManager.
+// It plays its events on its own MIDI channel, so the drum channel keeps
+// FluidSynth's percussion defaults. Stereo only.
+class FluidInstance final : public RenderInstance {
+  public:
+    FluidInstance(ErrorSystem::Logger *pErr, fluid_settings_t *settings,
+                  uint8_t channel, uint32_t sampleRate, size_t evbufCapacity);
+    ~FluidInstance();
+
+    uint64_t VoiceCount() override;
+    bool SetSoundFonts(const void *fonts, size_t count) override;
+    uint8_t PartChannel() const override { return channel; }
+
+  protected:
+    void PlayEvents(const uint32_t *events, size_t count) override;
+    void PlayReset(uint8_t type) override;
+    void PlayLongEvent(const uint8_t *data, size_t len) override;
+    int RenderSamples(float *buffer, size_t count) override;
+
+  private:
+    fluid_synth_t *synth = nullptr;
+    uint8_t channel = 0;
+    std::vector<int> sfids;
+};
+} // namespace OmniMIDI
+
+#endif
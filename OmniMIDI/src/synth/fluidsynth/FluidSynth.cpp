@@ -22,32 +22,55 @@
 #ifdef _OFLUIDSYNTH_H
 
 void OmniMIDI::FluidSynth::EventsThread() {
-    // Spin while waiting for the stream to go online
-    while (!AudioDrivers[0])
-        Utils.MicroSleep(SLEEPVAL(1));
+    RTThread::Promote(ErrLog, _fluidConfig->GetRTConfig(), "FluidEvents");
 
     for (size_t i = 0; i < AudioStreamSize; i++)
         fluid_synth_system_reset(AudioStreams[i]);
 
     while (IsSynthInitialized()) {
-        if (!ProcessEvBuf())
+        if (!ProcessEvBuf()) {
+            if (thread_mgr) {
+                ActiveVoices = thread_mgr->GetActiveVoices();
+                RenderingTime = thread_mgr->GetRenderingTime();
+                if (LogEventStats())
+                    thread_mgr->LogThreadStats();
+            } else {
+                LogEventStats();
+            }
+
             Utils.MicroSleep(SLEEPVAL(1));
+        }
     }
 }
 
 bool OmniMIDI::FluidSynth::ProcessEvBuf() {
+    if (!IsSynthInitialized())
+        return false;
+
+    auto evs = ShortEvents->AcquireReadable();
+
+    if (evs.empty())
+        return false;
+
+    if (thread_mgr) {
+        thread_mgr->ForwardEvents(evs, nullptr, LongEvents);
+    } else {
+        for (auto evtDword : evs)
+            ProcessEvent(evtDword);
+    }
+
+    ShortEvents->Release(evs.size());
+    return true;
+}
+
+void OmniMIDI::FluidSynth::ProcessEvent(ShortEvent evtDword) {
     // SysEx
     int32_t len = 0;
     int32_t handled = 0;
     uint32_t sysev = 0;
 
-    if (!AudioDrivers[0])
-        return false;
-
-    auto evtDword = ShortEvents->Read();
-
     if (!evtDword)
-        return false;
+        return;
 
     uint8_t status = MIDIUtils::GetStatus(evtDword);
     uint8_t command = MIDIUtils::GetCommand(status);
@@ -56,9 +79,21 @@ bool OmniMIDI::FluidSynth::ProcessEvBuf() {
     uint8_t param1 = MIDIUtils::GetFirstParam(evtDword);
     uint8_t param2 = MIDIUtils::GetSecondParam(evtDword);
 
-    fluid_synth_t *targetStream = _fluidConfig->ExperimentalMultiThreaded
-                                      ? AudioStreams[chan]
-                                      : AudioStreams[0];
+    fluid_synth_t *targetStream = AudioStreams[0];
+
+    if (inSysEx) {
+        if (status == SystemMessageEnd) {
+            Message("SysEx End");
+            inSysEx = false;
+            return;
+        }
+
+        sysev = evtDword;
+        Message("SysEx Ev: %x", sysev);
+        fluid_synth_sysex(targetStream, (const char *)&sysev, 3, 0, &len,
+                          &handled, 0);
+        return;
+    }
 
     switch (command) {
     case NoteOn:
@@ -96,6 +131,8 @@ bool OmniMIDI::FluidSynth::ProcessEvBuf() {
         switch (status) {
 
         // Let's go!
+        // The data that follows is forwarded as it comes in,
+        // until SystemMessageEnd shows up
         case SystemMessageStart:
             sysev = evtDword;
 
@@ -103,18 +140,7 @@ bool OmniMIDI::FluidSynth::ProcessEvBuf() {
             fluid_synth_sysex(targetStream, (const char *)&sysev, 2, 0, &len,
                               &handled, 0);
 
-            while (MIDIUtils::GetStatus(sysev) != SystemMessageEnd) {
-                sysev = ShortEvents->Peek();
-
-                if (MIDIUtils::GetStatus(sysev) != SystemMessageEnd) {
-                    sysev = ShortEvents->Read();
-                    Message("SysEx Ev: %x", sysev);
-                    fluid_synth_sysex(targetStream, (const char *)&sysev, 3, 0,
-                                      &len, &handled, 0);
-                }
-            }
-
-            Message("SysEx End", sysev);
+            inSysEx = true;
             break;
 
         case SystemReset:
@@ -125,23 +151,31 @@ bool OmniMIDI::FluidSynth::ProcessEvBuf() {
             }
             break;
 
-        case Unknown1:
-        case Unknown2:
-        case Unknown3:
-        case Unknown4:
-            return false;
-
         default:
             break;
         }
 
         break;
     }
-
-    return true;
 }
 
 void OmniMIDI::FluidSynth::LoadSoundFonts() {
+    if (thread_mgr) {
+        std::vector<const char *> paths;
+
+        if ((_sfVec = _sfSystem.LoadList()) != nullptr) {
+            for (auto &sf : *_sfVec) {
+                if (sf.enabled)
+                    paths.push_back(sf.path.c_str());
+            }
+        }
+
+        if (!thread_mgr->SetSoundFonts(paths))
+            Error("Some soundfonts failed to load.", false);
+
+        return;
+    }
+
     // Free old SFs
     for (auto i = 0;
          i < std::count(SoundFontIDs.begin(), SoundFontIDs.end(), -1); i++) {
@@ -192,7 +226,14 @@ bool OmniMIDI::FluidSynth::LoadSynthModule() {
             return false;
         }
 
-        _SinEvtThread = std::jthread(&FluidSynth::EventsThread, this);
+        Events->SetOverflowPolicy(
+            (EvBufOverflow)_fluidConfig->EvBufOverflowPolicy);
+
+        // Only used when the instances are split, see UPlayLongEvent()
+        if (!AllocateLongEvBuf(DEF_LEVBUF_SIZE)) {
+            Error("AllocateLongEvBuf failed.", true);
+            return false;
+        }
     }
 
     return true;
@@ -202,8 +243,10 @@ bool OmniMIDI::FluidSynth::UnloadSynthModule() {
     if (!FluiLib || !FluiLib->IsOnline())
         return true;
 
-    if (!AudioStreams[0] && !AudioDrivers[0]) {
+    if (!AudioStreams[0] && !AudioDrivers[0] && !thread_mgr) {
+        LogEventStats(true);
         FreeShortEvBuf();
+        FreeLongEvBuf();
         FreeSynthConfig(_fluidConfig);
 
         delete_fluid_settings(fSet);
@@ -232,9 +275,8 @@ bool OmniMIDI::FluidSynth::StartSynthModule() {
         return false;
     }
 
-    if (_fluidConfig->ExperimentalMultiThreaded ||
-        (_fluidConfig->ThreadsCount < 1 ||
-         _fluidConfig->ThreadsCount > std::thread::hardware_concurrency()))
+    if (_fluidConfig->ThreadsCount < 1 ||
+        _fluidConfig->ThreadsCount > std::thread::hardware_concurrency())
         _fluidConfig->ThreadsCount = 1;
 
     fluid_settings_setint(fSet, "synth.cpu-cores",
@@ -262,8 +304,46 @@ bool OmniMIDI::FluidSynth::StartSynthModule() {
                           _fluidConfig->SampleFormat.c_str());
     fluid_settings_setstr(fSet, "synth.midi-bank-select", "xg");
 
-    if (!_fluidConfig->ExperimentalMultiThreaded)
+    // FluidSynth's audio driver threads are its own, but it can promote them
+    // by itself, leave its default alone unless asked to
+    RTConfig rt = _fluidConfig->GetRTConfig();
+    if (rt.Policy != RTNone)
+        fluid_settings_setint(fSet, "audio.realtime-prio", rt.Priority);
+
+    if (_fluidConfig->ExperimentalMultiThreaded) {
+        // The ThreadManager renders the instances, FluidSynth's own
+        // threads stay out of it
+        ThreadManagerConfig cfg;
+        cfg.SampleRate = _fluidConfig->SampleRate;
+        cfg.AudioChannels = 2;
+        cfg.KeyboardDivisions = _fluidConfig->KeyboardDivisions;
+        cfg.RenderSize = _fluidConfig->PeriodSize;
+        cfg.RT = rt;
+
+        // ThreadsCount is synth.cpu-cores otherwise, 1 by default, which
+        // would render the instances one after the other
+        cfg.ThreadCount = _fluidConfig->ThreadsCount > 1
+                              ? _fluidConfig->ThreadsCount
+                              : std::thread::hardware_concurrency();
+
+        auto factory = [this](uint32_t channel,
+                              uint32_t division) -> RenderInstance * {
+            return new FluidInstance(ErrLog, fSet, (uint8_t)channel,
+                                     _fluidConfig->SampleRate,
+                                     _fluidConfig->EvBufSize);
+        };
+
+        AudioStreamSize = 0;
+
+        try {
+            thread_mgr = new ThreadManager(ErrLog, cfg, factory);
+        } catch (const std::exception &e) {
+            Error("ThreadManager intialization failed: %s", true, e.what());
+            return false;
+        }
+    } else {
         AudioStreamSize = 1;
+    }
 
     for (size_t i = 0; i < AudioStreamSize; i++) {
         AudioStreams[i] = new_fluid_synth(fSet);
@@ -282,17 +362,35 @@ bool OmniMIDI::FluidSynth::StartSynthModule() {
 
     StopDebugOutput();
 
+    if (rt.LockMemory)
+        RTThread::LockMemory(ErrLog);
+
     LoadSoundFonts();
     _sfSystem.RegisterCallback(this);
 
+    isActive = true;
+    _SinEvtThread = std::jthread(&FluidSynth::EventsThread, this);
+
     Message("fSyn and fDrv are operational. FluidSynth is now working.");
     return true;
 }
 
 bool OmniMIDI::FluidSynth::StopSynthModule() {
+    isActive = false;
+
     _sfSystem.RegisterCallback();
     _sfSystem.ClearList();
 
+    if (_SinEvtThread.joinable()) {
+        _SinEvtThread.join();
+        Message("_SinEvtThread freed.");
+    }
+
+    if (thread_mgr) {
+        delete thread_mgr;
+        thread_mgr = nullptr;
+    }
+
     for (size_t i = 0; i < AudioStreamSize; i++) {
         if (AudioDrivers[i]) {
             delete_fluid_audio_driver(AudioDrivers[i]);
@@ -318,12 +416,24 @@ uint32_t OmniMIDI::FluidSynth::PlayLongEvent(uint8_t *ev, uint32_t size) {
     if (!IsSynthInitialized())
         return 0;
 
+    // F0, at least one byte of data, F7
+    if (size < 3)
+        return 0;
+
     return UPlayLongEvent(ev, size);
 }
 
 uint32_t OmniMIDI::FluidSynth::UPlayLongEvent(uint8_t *ev, uint32_t size) {
     int resp_len = 0;
 
+    // The instances get it from the events thread, in order with the short
+    // events, see ThreadManager::ForwardEvents()
+    if (thread_mgr)
+        return LongEvents->WriteLinked(ev, size, ShortEvents,
+                                       SystemMessageStart)
+                   ? size
+                   : 0;
+
     // Ignore 0xF0 and 0xF7
     fluid_synth_sysex(AudioStreams[0], (const char *)(ev + 1), size - 2, 0,
                       &resp_len, 0, 0);
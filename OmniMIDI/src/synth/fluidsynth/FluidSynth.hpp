@@ -21,11 +21,17 @@
 #define _OFLUIDSYNTH_H
 
 #include "../SynthModule.hpp"
+#include "../ThreadMgr.hpp"
+#include "FluidInstance.hpp"
 
 #include "fluidsynth.h"
 
 #define FLUIDSYNTH_STR "FluidSynth"
 
+// Every FluidInstance loads its own copy of the soundfonts, see
+// FluidSettings::KeyboardDivisions
+#define FLUID_MAX_KBDIV 4
+
 #ifdef _WIN32
 #define FLUIDLIB "libfluidsynth-3"
 #define FLUIDSFX nullptr
@@ -41,11 +47,18 @@ class FluidSettings : public SettingsModule {
   public:
     // Global settings
     uint64_t EvBufSize = 32768;
+    uint32_t EvBufOverflowPolicy = OverflowDrop;
     uint32_t PeriodSize = 64;
     uint32_t Periods = 2;
     uint32_t ThreadsCount = 1;
     uint32_t MinimumNoteLength = 10;
     bool ExperimentalMultiThreaded = false;
+
+    // ExperimentalMultiThreaded splits each channel across this many
+    // FluidInstances. Each one loads every soundfont on its own, so the
+    // samples end up in memory 16 * KeyboardDivisions times, hence the
+    // FLUID_MAX_KBDIV cap
+    uint32_t KeyboardDivisions = 1;
     double OverflowVolume = 10000.0;
     double OverflowPercussion = 10000.0;
     double OverflowReleased = -10000.0;
@@ -58,6 +71,7 @@ class FluidSettings : public SettingsModule {
     void RewriteSynthConfig() {
         nlohmann::json DefConfig = {ConfGetVal(SampleRate),
                                     ConfGetVal(EvBufSize),
+                                    ConfGetVal(EvBufOverflowPolicy),
                                     ConfGetVal(VoiceLimit),
                                     ConfGetVal(PeriodSize),
                                     ConfGetVal(Periods),
@@ -69,7 +83,12 @@ class FluidSettings : public SettingsModule {
                                     ConfGetVal(OverflowImportant),
                                     ConfGetVal(Driver),
                                     ConfGetVal(SampleFormat),
-                                    ConfGetVal(ExperimentalMultiThreaded)};
+                                    ConfGetVal(RTPolicy),
+                                    ConfGetVal(RTPriority),
+                                    ConfGetVal(RTAffinity),
+                                    ConfGetVal(LockMemory),
+                                    ConfGetVal(ExperimentalMultiThreaded),
+                                    ConfGetVal(KeyboardDivisions)};
 
         if (AppendToConfig(DefConfig))
             WriteConfig();
@@ -83,18 +102,37 @@ class FluidSettings : public SettingsModule {
         if (InitConfig(false, FLUIDSYNTH_STR)) {
             SynthSetVal(uint32_t, SampleRate);
             SynthSetVal(uint32_t, EvBufSize);
+            SynthSetVal(uint32_t, EvBufOverflowPolicy);
             SynthSetVal(uint32_t, VoiceLimit);
             SynthSetVal(uint32_t, PeriodSize);
             SynthSetVal(uint32_t, Periods);
             SynthSetVal(uint32_t, ThreadsCount);
             SynthSetVal(uint32_t, MinimumNoteLength);
             SynthSetVal(bool, ExperimentalMultiThreaded);
+            SynthSetVal(uint32_t, KeyboardDivisions);
             SynthSetVal(double, OverflowVolume);
             SynthSetVal(double, OverflowPercussion);
             SynthSetVal(double, OverflowReleased);
             SynthSetVal(double, OverflowImportant);
             SynthSetVal(std::string, Driver);
             SynthSetVal(std::string, SampleFormat);
+            SynthSetVal(uint32_t, RTPolicy);
+            SynthSetVal(int32_t, RTPriority);
+            SynthSetVal(std::string, RTAffinity);
+            SynthSetVal(bool, LockMemory);
+
+            if (EvBufOverflowPolicy > OVERFLOW_COUNT)
+                EvBufOverflowPolicy = OverflowDrop;
+
+            if (KeyboardDivisions < 1)
+                KeyboardDivisions = 1;
+            else if (KeyboardDivisions > FLUID_MAX_KBDIV) {
+                Message("KeyboardDivisions capped to %u, every division "
+                        "loads its own copy of the soundfonts.",
+                        FLUID_MAX_KBDIV);
+                KeyboardDivisions = FLUID_MAX_KBDIV;
+            }
+
             return;
         }
 
@@ -104,11 +142,11 @@ class FluidSettings : public SettingsModule {
     }
 };
 
-class FluidSynth : public SynthModule {
+class FluidSynth final : public BufferedSynthModule<LanedEvBuf> {
   private:
     Lib *FluiLib = nullptr;
 
-    LibImport fLibImp[25] = {// BASS
+    LibImport fLibImp[27] = {// BASS
                              ImpFunc(new_fluid_synth),
                              ImpFunc(new_fluid_settings),
                              ImpFunc(delete_fluid_synth),
@@ -127,6 +165,8 @@ class FluidSynth : public SynthModule {
                              ImpFunc(fluid_synth_program_select),
                              ImpFunc(fluid_synth_sysex),
                              ImpFunc(fluid_synth_system_reset),
+                             ImpFunc(fluid_synth_write_float),
+                             ImpFunc(fluid_synth_get_active_voice_count),
                              ImpFunc(fluid_synth_sfunload),
                              ImpFunc(fluid_synth_sfload),
                              ImpFunc(fluid_settings_setint),
@@ -145,13 +185,26 @@ class FluidSynth : public SynthModule {
     fluid_audio_driver_t **AudioDrivers = new fluid_audio_driver_t *[16]{0};
     size_t AudioStreamSize = 16;
 
+    // ExperimentalMultiThreaded, the channels are split across
+    // FluidInstances instead of getting a synth and a driver each
+    ThreadManager *thread_mgr = nullptr;
+
+    // Keeps the events thread running, it goes through thread_mgr, so
+    // StopSynthModule() clears it and joins the thread before freeing
+    // anything
+    std::atomic<bool> isActive = false;
+
     std::vector<int> SoundFonts;
 
+    // A SysEx message can span more than one batch
+    bool inSysEx = false;
+
     void EventsThread();
     bool ProcessEvBuf();
+    void ProcessEvent(ShortEvent evtDword);
 
   public:
-    FluidSynth(ErrorSystem::Logger *PErr) : SynthModule(PErr) {}
+    FluidSynth(ErrorSystem::Logger *PErr) : BufferedSynthModule(PErr) {}
     bool LoadSynthModule() override;
     bool UnloadSynthModule() override;
     bool StartSynthModule() override;
@@ -162,8 +215,14 @@ class FluidSynth : public SynthModule {
         return false;
     }
     uint32_t GetSampleRate() override { return _fluidConfig->SampleRate; }
-    bool IsSynthInitialized() override { return (AudioDrivers[0] != nullptr); }
+    bool IsSynthInitialized() override { return isActive; }
     uint32_t SynthID() override { return 0x6F704EC6; }
+    void GetAudioStats(AudioMetrics &m) override {
+        if (thread_mgr)
+            thread_mgr->GetAudioStats(m);
+        else
+            m = {};
+    }
 
     uint32_t PlayLongEvent(uint8_t *ev, uint32_t size) override;
     uint32_t UPlayLongEvent(uint8_t *ev, uint32_t size) override;
@@ -49,7 +49,7 @@ struct PluginFuncs {
 typedef PluginFuncs *(*OMv2PEP)();
 
 namespace OmniMIDI {
-class PluginSynth : public SynthModule {
+class PluginSynth final : public SynthModule {
   protected:
     bool Init = false;
     Lib *Plugin = nullptr;
@@ -0,0 +1,157 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+#include "XSynthInstance.hpp"
+
+#ifdef _XSYNTHINSTANCE_H
+
+#include <stdexcept>
+
+OmniMIDI::XSynthInstance::XSynthInstance(ErrorSystem::Logger *pErr,
+                                         uint32_t sampleRate, uint16_t layers,
+                                         bool fadeOutKilling, bool drums)
+    : RenderInstance(pErr, sampleRate, 2, XSYNTH_INSTANCE_EVBUF, false) {
+    XSynth_GroupOptions options = XSynth_GenDefault_GroupOptions();
+
+    options.stream_params.sample_rate = sampleRate;
+    options.stream_params.audio_channels = XSYNTH_AUDIO_CHANNELS_STEREO;
+    options.channels = 1;
+    options.fade_out_killing = fadeOutKilling;
+
+    // The ThreadManager is the one doing the parallel work
+    options.parallelism.channel = -1;
+    options.parallelism.key = -1;
+
+    group = XSynth_ChannelGroup_Create(options);
+    if (!group.group)
+        throw std::runtime_error("XSynth_ChannelGroup_Create failed!");
+
+    XSynth_ChannelGroup_SendConfigEventAll(group, XSYNTH_CONFIG_SETLAYERS,
+                                           layers);
+
+    if (drums)
+        XSynth_ChannelGroup_SendConfigEvent(
+            group, 0, XSYNTH_CONFIG_SETPERCUSSIONMODE, 1);
+}
+
+OmniMIDI::XSynthInstance::~XSynthInstance() {
+    XSynth_ChannelGroup_Drop(group);
+}
+
+uint64_t OmniMIDI::XSynthInstance::VoiceCount() {
+    return XSynth_ChannelGroup_VoiceCount(group);
+}
+
+bool OmniMIDI::XSynthInstance::SetSoundFonts(const void *fonts,
+                                             size_t count) {
+    std::lock_guard<std::mutex> lock(group_lock);
+
+    if (count)
+        XSynth_ChannelGroup_SetSoundfonts(
+            group, (const XSynth_Soundfont *)fonts, count);
+    else
+        XSynth_ChannelGroup_ClearSoundfonts(group);
+
+    MarkPending();
+    return true;
+}
+
+void OmniMIDI::XSynthInstance::PlayEvents(const uint32_t *events,
+                                          size_t count) {
+    std::lock_guard<std::mutex> lock(group_lock);
+
+    for (size_t i = 0; i < count; i++) {
+        uint8_t status = MIDIUtils::GetStatus(events[i]);
+        uint8_t param1 = MIDIUtils::GetFirstParam(events[i]);
+        uint8_t param2 = MIDIUtils::GetSecondParam(events[i]);
+        uint16_t event = 0, params = 0;
+
+        switch (MIDIUtils::GetCommand(status)) {
+        case NoteOn:
+            // The low byte is the key, the high one the velocity
+            event = param2 ? XSYNTH_AUDIO_EVENT_NOTEON
+                           : XSYNTH_AUDIO_EVENT_NOTEOFF;
+            params = param2 ? MIDIUtils::MakeFullParam(param1, param2, 8)
+                            : param1;
+            break;
+
+        case NoteOff:
+            event = XSYNTH_AUDIO_EVENT_NOTEOFF;
+            params = param1;
+            break;
+
+        case CC:
+            switch (param1) {
+            case 120: // All sound off
+                event = XSYNTH_AUDIO_EVENT_ALLNOTESKILLED;
+                break;
+
+            case 121: // Reset all controllers
+                event = XSYNTH_AUDIO_EVENT_RESETCONTROL;
+                break;
+
+            case 123: // All notes off
+                event = XSYNTH_AUDIO_EVENT_ALLNOTESOFF;
+                break;
+
+            default:
+                event = XSYNTH_AUDIO_EVENT_CONTROL;
+                params = MIDIUtils::MakeFullParam(param1, param2, 8);
+                break;
+            }
+            break;
+
+        case PatchChange:
+            event = XSYNTH_AUDIO_EVENT_PROGRAMCHANGE;
+            params = param1;
+            break;
+
+        case PitchBend:
+            event = XSYNTH_AUDIO_EVENT_PITCH;
+            params = MIDIUtils::MakeFullParam(param1, param2, 7);
+            break;
+
+        // No aftertouch or channel pressure in XSynth
+        default:
+            continue;
+        }
+
+        XSynth_ChannelGroup_SendAudioEvent(group, 0, event, params);
+    }
+}
+
+void OmniMIDI::XSynthInstance::PlayReset(uint8_t type) {
+    std::lock_guard<std::mutex> lock(group_lock);
+
+    XSynth_ChannelGroup_SendAudioEventAll(
+        group, XSYNTH_AUDIO_EVENT_ALLNOTESKILLED, 0);
+    XSynth_ChannelGroup_SendAudioEventAll(group,
+                                          XSYNTH_AUDIO_EVENT_RESETCONTROL, 0);
+    XSynth_ChannelGroup_SendAudioEventAll(
+        group, XSYNTH_AUDIO_EVENT_PROGRAMCHANGE, 0);
+}
+
+int OmniMIDI::XSynthInstance::RenderSamples(float *buffer, size_t count) {
+    std::lock_guard<std::mutex> lock(group_lock);
+
+    XSynth_ChannelGroup_ReadSamples(group, buffer, count);
+    return (int)count;
+}
+
+#endif
@@ -0,0 +1,65 @@
+/*
+ * SPDX-License-Identifier: MIT
+ *
+ * OmniMIDI
+ *
+ * Copyright (c) 2024 Keppy's Software
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the MIT License.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * MIT License for more details.
+ *
+ * You should have received a copy of the MIT License along with this
+ * program.  If not, see <https://opensource.org/license/mit/>.
+ */
+
+#include "../../Common.hpp"
+
+// Not supported on ARM Thumb-2!
+#ifndef _M_ARM
+
+#ifndef _XSYNTHINSTANCE_H
+#define _XSYNTHINSTANCE_H
+
+#include "../RenderInstance.hpp"
+#include "xsynth.h"
+#include <mutex>
+
+// XSynth has no event buffer of its own to size this from
+#define XSYNTH_INSTANCE_EVBUF 32768
+
+namespace OmniMIDI {
+// A single channel XSynth channel group, rendered by the ThreadManager.
+// The events come in as raw MIDI, and get translated to XSynth's audio
+// events here.
+class XSynthInstance final : public RenderInstance {
+  public:
+    XSynthInstance(ErrorSystem::Logger *pErr, uint32_t sampleRate,
+                   uint16_t layers, bool fadeOutKilling, bool drums);
+    ~XSynthInstance();
+
+    uint64_t VoiceCount() override;
+    bool SetSoundFonts(const void *fonts, size_t count) override;
+
+  protected:
+    void PlayEvents(const uint32_t *events, size_t count) override;
+    void PlayReset(uint8_t type) override;
+    int RenderSamples(float *buffer, size_t count) override;
+
+  private:
+    XSynth_ChannelGroup group;
+
+    // A channel group can't be touched from two threads at once, and the
+    // soundfonts are set from outside the render thread. Uncontended
+    // unless the soundfonts are being swapped.
+    std::mutex group_lock;
+};
+} // namespace OmniMIDI
+
+#endif
+
+#endif
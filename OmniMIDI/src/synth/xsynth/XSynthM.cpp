@@ -26,20 +26,30 @@ void OmniMIDI::XSynth::XSynthThread() {
         Utils.MicroSleep(SLEEPVAL(1));
 
     while (IsSynthInitialized()) {
-        realtimeStats = XSynth_Realtime_GetStats(realtimeSynth);
-
-        RenderingTime = realtimeStats.render_time * 100.0f;
-        ActiveVoices = realtimeStats.voice_count;
+        if (thread_mgr) {
+            RenderingTime = thread_mgr->GetRenderingTime();
+            ActiveVoices = thread_mgr->GetActiveVoices();
+        } else {
+            realtimeStats = XSynth_Realtime_GetStats(realtimeSynth);
+
+            RenderingTime = realtimeStats.render_time * 100.0f;
+            ActiveVoices = realtimeStats.voice_count;
+        }
 
         Utils.MicroSleep(SLEEPVAL(10000));
     }
 }
 
 void OmniMIDI::XSynth::UnloadSoundfonts() {
+    // Let go of the handles before removing them
+    if (thread_mgr)
+        thread_mgr->ClearSoundFonts();
+    else
+        XSynth_Realtime_ClearSoundfonts(realtimeSynth);
+
     for (auto sf : SoundFonts) {
         XSynth_Soundfont_Remove(sf);
     }
-    XSynth_Realtime_ClearSoundfonts(realtimeSynth);
     SoundFonts.clear();
 }
 
@@ -99,6 +109,60 @@ bool OmniMIDI::XSynth::StartSynthModule() {
     if (!_XSyConfig)
         return false;
 
+    if (_XSyConfig->ExperimentalMultiThreaded) {
+        ThreadManagerConfig cfg;
+        cfg.SampleRate = _XSyConfig->SampleRate;
+        cfg.AudioChannels = 2;
+        cfg.KeyboardDivisions = _XSyConfig->KeyboardDivisions;
+        cfg.RenderSize = (size_t)std::max(
+            _XSyConfig->SampleRate * _XSyConfig->RenderWindow / 1000.0, 1.0);
+        cfg.MinRenderSize = (size_t)std::max(
+            _XSyConfig->SampleRate * _XSyConfig->MinRenderWindow / 1000.0,
+            1.0);
+        cfg.MaxRenderSize = (size_t)std::max(
+            _XSyConfig->SampleRate * _XSyConfig->MaxRenderWindow / 1000.0,
+            1.0);
+        cfg.LatencyBias = _XSyConfig->LatencyBias;
+        cfg.RT = _XSyConfig->GetRTConfig();
+
+        // Same meaning as for the realtime synth: -1 for none, 0 for auto
+        if (_XSyConfig->ThreadsCount > 0)
+            cfg.ThreadCount = _XSyConfig->ThreadsCount;
+        else if (_XSyConfig->ThreadsCount < 0)
+            cfg.ThreadCount = 1;
+        else
+            cfg.ThreadCount = std::thread::hardware_concurrency();
+
+        auto factory = [this](uint32_t channel,
+                              uint32_t division) -> RenderInstance * {
+            return new XSynthInstance(ErrLog, _XSyConfig->SampleRate,
+                                      _XSyConfig->LayerCount,
+                                      _XSyConfig->FadeOutKilling,
+                                      channel == 9);
+        };
+
+        try {
+            thread_mgr = new ThreadManager(ErrLog, cfg, factory);
+        } catch (const std::exception &e) {
+            Error("ThreadManager intialization failed: %s", true, e.what());
+            return false;
+        }
+
+        LoadSoundFonts();
+        _sfSystem.RegisterCallback(this);
+
+        _XSyThread = std::jthread(&XSynth::XSynthThread, this);
+        if (!_XSyThread.joinable()) {
+            Error("_XSyThread failed. (ID: %x)", true, _XSyThread.get_id());
+            return false;
+        }
+
+        StartDebugOutput();
+
+        Running = true;
+        return Running;
+    }
+
     realtimeConf = XSynth_GenDefault_RealtimeConfig();
 
     realtimeConf.fade_out_killing = _XSyConfig->FadeOutKilling;
@@ -134,12 +198,21 @@ bool OmniMIDI::XSynth::StopSynthModule() {
     if (IsSynthInitialized()) {
         Running = false;
         UnloadSoundfonts();
-        XSynth_Realtime_Drop(realtimeSynth);
+
+        if (!thread_mgr)
+            XSynth_Realtime_Drop(realtimeSynth);
     }
 
     if (_XSyThread.joinable())
         _XSyThread.join();
 
+    if (thread_mgr) {
+        // UPlayShortEvent() could be sending to it
+        std::lock_guard<std::mutex> lock(EventLock);
+        delete thread_mgr;
+        thread_mgr = nullptr;
+    }
+
     StopDebugOutput();
 
     return true;
@@ -156,7 +229,12 @@ void OmniMIDI::XSynth::LoadSoundFonts() {
 
         auto &_sfVecIter = *_sfVec;
         auto sf = XSynth_GenDefault_SoundfontOptions();
-        auto realtimeParams = XSynth_Realtime_GetStreamParams(realtimeSynth);
+        XSynth_StreamParams realtimeParams;
+        if (thread_mgr)
+            realtimeParams = {_XSyConfig->SampleRate,
+                              XSYNTH_AUDIO_CHANNELS_STEREO};
+        else
+            realtimeParams = XSynth_Realtime_GetStreamParams(realtimeSynth);
 
         if (_sfVecIter.size() < 1)
             return;
@@ -191,8 +269,11 @@ void OmniMIDI::XSynth::LoadSoundFonts() {
         }
 
         if (SoundFonts.size() > 0) {
-            XSynth_Realtime_SetSoundfonts(realtimeSynth, &SoundFonts[0],
-                                          SoundFonts.size());
+            if (thread_mgr)
+                thread_mgr->SetSoundFonts(SoundFonts);
+            else
+                XSynth_Realtime_SetSoundfonts(realtimeSynth, &SoundFonts[0],
+                                              SoundFonts.size());
         }
     }
 }
@@ -205,6 +286,15 @@ void OmniMIDI::XSynth::PlayShortEvent(unsigned int ev) {
 }
 
 void OmniMIDI::XSynth::UPlayShortEvent(unsigned int ev) {
+    if (thread_mgr) {
+        std::lock_guard<std::mutex> lock(EventLock);
+
+        // StopSynthModule() could have freed it in the meantime
+        if (thread_mgr)
+            thread_mgr->SendEvent(ev);
+        return;
+    }
+
     XSynth_Realtime_SendEventU32(realtimeSynth, ev);
 }
 
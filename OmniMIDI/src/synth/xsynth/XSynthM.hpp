@@ -26,6 +26,9 @@
 #define _XSYNTHM_H
 
 #include "../SynthModule.hpp"
+#include "../ThreadMgr.hpp"
+#include "XSynthInstance.hpp"
+#include <mutex>
 
 #include "xsynth.h"
 
@@ -41,13 +44,32 @@ class XSynthSettings : public SettingsModule {
     int32_t ThreadsCount = 0;
     uint8_t Interpolation = XSYNTH_INTERPOLATION_NEAREST;
 
+    // Renders through single channel groups driven by OmniMIDI's own
+    // ThreadManager, instead of XSynth's realtime synth. SampleRate only
+    // applies to this mode.
+    bool ExperimentalMultiThreaded = false;
+    uint32_t KeyboardDivisions = 1;
+
+    // Bounds that mode tunes RenderWindow within (ms), from its load and
+    // the underruns, see BufferedRenderer::AutoTune. It starts from
+    // RenderWindow, and doesn't tune anything if MaxRenderWindow isn't past
+    // MinRenderWindow. LatencyBias goes from 0 (latency) to 100 (safety)
+    double MinRenderWindow = 10.0;
+    double MaxRenderWindow = 40.0;
+    uint32_t LatencyBias = 50;
+
     XSynthSettings(ErrorSystem::Logger *PErr) : SettingsModule(PErr) {}
 
     void RewriteSynthConfig() {
         nlohmann::json DefConfig = {
             ConfGetVal(FadeOutKilling), ConfGetVal(RenderWindow),
             ConfGetVal(ThreadsCount),   ConfGetVal(LayerCount),
-            ConfGetVal(Interpolation),
+            ConfGetVal(Interpolation),  ConfGetVal(SampleRate),
+            ConfGetVal(ExperimentalMultiThreaded),
+            ConfGetVal(KeyboardDivisions),
+            ConfGetVal(MinRenderWindow),
+            ConfGetVal(MaxRenderWindow),
+            ConfGetVal(LatencyBias),
         };
 
         if (AppendToConfig(DefConfig))
@@ -65,6 +87,12 @@ class XSynthSettings : public SettingsModule {
             SynthSetVal(int32_t, ThreadsCount);
             SynthSetVal(uint16_t, LayerCount);
             SynthSetVal(uint8_t, Interpolation);
+            SynthSetVal(uint32_t, SampleRate);
+            SynthSetVal(bool, ExperimentalMultiThreaded);
+            SynthSetVal(uint32_t, KeyboardDivisions);
+            SynthSetVal(double, MinRenderWindow);
+            SynthSetVal(double, MaxRenderWindow);
+            SynthSetVal(uint32_t, LatencyBias);
 
             if (!RANGE(ThreadsCount, -1,
                        (int32_t)std::thread::hardware_concurrency()))
@@ -73,6 +101,21 @@ class XSynthSettings : public SettingsModule {
             if (!RANGE(LayerCount, 1, UINT16_MAX))
                 LayerCount = 4;
 
+            if (SampleRate == 0 || SampleRate > 384000)
+                SampleRate = 48000;
+
+            if (KeyboardDivisions < 1 || KeyboardDivisions > 128)
+                KeyboardDivisions = 1;
+
+            if (MinRenderWindow <= 0.0 || MinRenderWindow > RenderWindow)
+                MinRenderWindow = RenderWindow;
+
+            if (MaxRenderWindow < RenderWindow || MaxRenderWindow > 1000.0)
+                MaxRenderWindow = RenderWindow;
+
+            if (LatencyBias > 100)
+                LatencyBias = 50;
+
             return;
         }
 
@@ -82,7 +125,7 @@ class XSynthSettings : public SettingsModule {
     }
 };
 
-class XSynth : public SynthModule {
+class XSynth final : public SynthModule {
   private:
     Lib *XLib = nullptr;
 
@@ -92,7 +135,7 @@ class XSynth : public SynthModule {
     XSynth_RealtimeStats realtimeStats;
     std::jthread _XSyThread;
 
-    LibImport xLibImp[14] = {ImpFunc(XSynth_GetVersion),
+    LibImport xLibImp[25] = {ImpFunc(XSynth_GetVersion),
                              ImpFunc(XSynth_GenDefault_RealtimeConfig),
                              ImpFunc(XSynth_GenDefault_SoundfontOptions),
                              ImpFunc(XSynth_Realtime_Drop),
@@ -105,13 +148,29 @@ class XSynth : public SynthModule {
                              ImpFunc(XSynth_Realtime_SetSoundfonts),
                              ImpFunc(XSynth_Realtime_ClearSoundfonts),
                              ImpFunc(XSynth_Soundfont_LoadNew),
-                             ImpFunc(XSynth_Soundfont_Remove)};
+                             ImpFunc(XSynth_Soundfont_Remove),
+                             ImpFunc(XSynth_GenDefault_GroupOptions),
+                             ImpFunc(XSynth_ChannelGroup_Create),
+                             ImpFunc(XSynth_ChannelGroup_SendAudioEvent),
+                             ImpFunc(XSynth_ChannelGroup_SendAudioEventAll),
+                             ImpFunc(XSynth_ChannelGroup_SendConfigEvent),
+                             ImpFunc(XSynth_ChannelGroup_SendConfigEventAll),
+                             ImpFunc(XSynth_ChannelGroup_SetSoundfonts),
+                             ImpFunc(XSynth_ChannelGroup_ClearSoundfonts),
+                             ImpFunc(XSynth_ChannelGroup_ReadSamples),
+                             ImpFunc(XSynth_ChannelGroup_VoiceCount),
+                             ImpFunc(XSynth_ChannelGroup_Drop)};
     size_t xLibImpLen = sizeof(xLibImp) / sizeof(xLibImp[0]);
 
     XSynthSettings *_XSyConfig = nullptr;
     SoundFontSystem _sfSystem;
     bool Running = false;
 
+    // ExperimentalMultiThreaded. Events can come from any thread here,
+    // the lock keeps the ThreadManager down to a single producer.
+    ThreadManager *thread_mgr = nullptr;
+    std::mutex EventLock;
+
     void XSynthThread();
     void UnloadSoundfonts();
 
@@ -125,14 +184,31 @@ class XSynth : public SynthModule {
                          size_t size) override {
         return false;
     }
-    uint32_t GetSampleRate() override { return 48000; }
+    uint32_t GetSampleRate() override {
+        // ExperimentalMultiThreaded renders at SampleRate
+        return thread_mgr ? _XSyConfig->SampleRate : 48000;
+    }
     bool IsSynthInitialized() override;
     uint32_t SynthID() override { return 0x9AF3812A; }
+    void GetAudioStats(AudioMetrics &m) override {
+        if (thread_mgr)
+            thread_mgr->GetAudioStats(m);
+        else
+            m = {};
+    }
     void LoadSoundFonts() override;
 
     // Event handling system
     void PlayShortEvent(uint32_t ev) override;
+    void PlayShortEvent(uint8_t status, uint8_t param1,
+                        uint8_t param2) override {
+        PlayShortEvent(status | (param1 << 8) | (param2 << 16));
+    }
     void UPlayShortEvent(uint32_t ev) override;
+    void UPlayShortEvent(uint8_t status, uint8_t param1,
+                         uint8_t param2) override {
+        UPlayShortEvent(status | (param1 << 8) | (param2 << 16));
+    }
 
     // Not supported in XSynth
     SynthResult TalkToSynthDirectly(uint32_t evt, uint32_t chan,
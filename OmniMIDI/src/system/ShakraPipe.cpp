@@ -68,7 +68,7 @@ bool OmniMIDI::ShakraPipe::StartSynthModule() {
 
 		if (temp) {
 			LongEvents = (LEvBuf*)temp;
-			LongEvents->Allocate(32);
+			LongEvents->Allocate(DEF_LEVBUF_SIZE);
 			Message("LongEvents mapping worked!");
 		}
 		else Error("An error occurred while mapping the view for the PLongEvents file mapping!", true);
@@ -174,6 +174,28 @@ uint64_t EXPORT GetVoiceCount() {
 
     return Host->GetActiveVoices();
 }
+
+// Fills an EvBufMetrics with the event pipeline counters,
+// cbStats has to match its size
+int32_t EXPORT GetEventStats(void *stats, uint32_t cbStats) {
+    if (Host == nullptr || stats == nullptr ||
+        cbStats != sizeof(OmniMIDI::EvBufMetrics))
+        return 0;
+
+    Host->GetEventStats(*(OmniMIDI::EvBufMetrics *)stats);
+    return 1;
+}
+
+// Fills an AudioMetrics with the output counters (underruns and such),
+// cbStats has to match its size
+int32_t EXPORT GetAudioStats(void *stats, uint32_t cbStats) {
+    if (Host == nullptr || stats == nullptr ||
+        cbStats != sizeof(AudioMetrics))
+        return 0;
+
+    Host->GetAudioStats(*(AudioMetrics *)stats);
+    return 1;
+}
 }
 
 #ifdef OM_STANDALONE
@@ -591,6 +591,28 @@ extern "C" {
 
 		return Host->GetActiveVoices();
 	}
+
+	// Fills an EvBufMetrics with the event pipeline counters,
+	// cbStats has to match its size
+	EXPORT int32_t WINAPI GetEventStats(void* stats, uint32_t cbStats) {
+		if (Host == nullptr || stats == nullptr ||
+			cbStats != sizeof(OmniMIDI::EvBufMetrics))
+			return 0;
+
+		Host->GetEventStats(*(OmniMIDI::EvBufMetrics*)stats);
+		return 1;
+	}
+
+	// Fills an AudioMetrics with the output counters (underruns and such),
+	// cbStats has to match its size
+	EXPORT int32_t WINAPI GetAudioStats(void* stats, uint32_t cbStats) {
+		if (Host == nullptr || stats == nullptr ||
+			cbStats != sizeof(AudioMetrics))
+			return 0;
+
+		Host->GetAudioStats(*(AudioMetrics*)stats);
+		return 1;
+	}
 }
 
 #endif
\ No newline at end of file
@@ -56,6 +56,8 @@ static int32_t (*lnk_DriverSettings)(uint32_t, uint32_t, void*, uint32_t) = NULL
 static int32_t (*lnk_LoadCustomSoundFontsList)(char*) = NULL;
 static float (*lnk_GetRenderingTime)() = NULL;
 static uint64_t (*lnk_GetVoiceCount)() = NULL;
+static int32_t (*lnk_GetEventStats)(void*, uint32_t) = NULL;
+static int32_t (*lnk_GetAudioStats)(void*, uint32_t) = NULL;
 
 static BOOL load_kdmapi() {
     if (kdmapi_handle != NULL) return TRUE;
@@ -80,6 +82,8 @@ static BOOL load_kdmapi() {
     lnk_LoadCustomSoundFontsList = dlsym(kdmapi_handle, "LoadCustomSoundFontsList");
     lnk_GetRenderingTime = dlsym(kdmapi_handle, "GetRenderingTime");
     lnk_GetVoiceCount = dlsym(kdmapi_handle, "GetVoiceCount");
+    lnk_GetEventStats = dlsym(kdmapi_handle, "GetEventStats");
+    lnk_GetAudioStats = dlsym(kdmapi_handle, "GetAudioStats");
 
     return TRUE;
 }
@@ -317,4 +321,18 @@ uint64_t WINAPI proxy_GetVoiceCount() {
         return 0;
 
     return lnk_GetVoiceCount();
+}
+
+int32_t WINAPI proxy_GetEventStats(void* stats, uint32_t cbStats) {
+    if (!lnk_GetEventStats)
+        return 0;
+
+    return lnk_GetEventStats(stats, cbStats);
+}
+
+int32_t WINAPI proxy_GetAudioStats(void* stats, uint32_t cbStats) {
+    if (!lnk_GetAudioStats)
+        return 0;
+
+    return lnk_GetAudioStats(stats, cbStats);
 }
\ No newline at end of file
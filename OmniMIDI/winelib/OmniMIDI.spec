@@ -16,4 +16,6 @@
 @ stdcall DriverSettings(long long ptr long) proxy_DriverSettings
 @ stdcall LoadCustomSoundFontsList(str) proxy_LoadCustomSoundFontsList
 @ stdcall GetRenderingTime() proxy_GetRenderingTime
-@ stdcall GetVoiceCount() proxy_GetVoiceCount
\ No newline at end of file
+@ stdcall GetVoiceCount() proxy_GetVoiceCount
+@ stdcall GetEventStats(ptr long) proxy_GetEventStats
+@ stdcall GetAudioStats(ptr long) proxy_GetAudioStats
\ No newline at end of file
@@ -15,10 +15,6 @@ option("nonfree")
     set_default(false)
     set_showmenu(true)
 
-option("statsdev")
-	set_default(false)
-	set_showmenu(true)
-
 -- Self-hosted MIDI out for Linux
 target("OmniMIDI")		
 	if is_plat("mingw") then 	
@@ -31,16 +27,11 @@ target("OmniMIDI")
 
 		-- Option definitions
 		set_options("nonfree")
-		set_options("statsdev")
 
 		if has_config("nonfree") then
 			add_defines("_NONFREE")
 		end
 
-		if has_config("statsdev") then
-			add_defines("_STATSDEV")
-		end
-
 		-- Target setup
 		if is_mode("debug") then
 			add_defines("DEBUG")
@@ -86,7 +77,6 @@ target("libOmniMIDI")
 
 	-- Option definitions
 	set_options("nonfree")
-	set_options("statsdev")
 
 	if is_plat("mingw") then
 		set_toolchains("mingw")
@@ -96,10 +86,6 @@ target("libOmniMIDI")
 		add_defines("_NONFREE")
 	end
 
-	if has_config("statsdev") then
-		add_defines("_STATSDEV")
-	end
-
 	if is_mode("debug") then
 		add_defines("DEBUG")
 		add_defines("_DEBUG")
@@ -147,4 +133,75 @@ target("libOmniMIDI")
 		remove_files("src/system/WDM*.cpp")
 		remove_files("src/system/StreamPlayer.cpp")
 	end
-target_end()
\ No newline at end of file
+target_end()
+
+-- Microbenchmarks, never built by default:
+--   xmake build bench_nps && xmake run bench_nps
+target("bench_nps")
+	set_kind("binary")
+	set_default(false)
+
+	if is_plat("mingw") then
+		set_enabled(false)
+	end
+
+	add_defines("NDEBUG")
+	set_optimize("fastest")
+
+	add_includedirs("inc")
+	add_files("bench/NpsBench.cpp", "src/audio/NpsLimiter.cpp")
+	add_files("src/Utils.cpp", "src/ErrSys.cpp")
+
+	add_cxflags("-Wall", "-msse2")
+target_end()
+
+target("bench_dispatch")
+	set_kind("binary")
+	set_default(false)
+	add_packages("nlohmann_json")
+
+	if is_plat("mingw") then
+		set_enabled(false)
+	end
+
+	add_defines("NDEBUG")
+	set_optimize("fastest")
+
+	add_includedirs("inc")
+	add_files("bench/DispatchBench.cpp", "src/synth/SynthModule.cpp")
+	add_files("src/RTThread.cpp", "src/Utils.cpp", "src/ErrSys.cpp")
+
+	add_cxflags("-Wall", "-msse2")
+target_end()
+
+target("bench_barrier")
+	set_kind("binary")
+	set_default(false)
+
+	if is_plat("mingw") then
+		set_enabled(false)
+	end
+
+	add_defines("NDEBUG")
+	set_optimize("fastest")
+
+	add_files("bench/BarrierBench.cpp")
+
+	add_cxflags("-Wall", "-msse2")
+target_end()
+
+target("bench_limiter")
+	set_kind("binary")
+	set_default(false)
+
+	if is_plat("mingw") then
+		set_enabled(false)
+	end
+
+	add_defines("NDEBUG")
+	set_optimize("fastest")
+
+	add_files("bench/LimiterBench.cpp", "src/audio/Limiter.cpp")
+
+	add_cxflags("-Wall", "-msse2")
+target_end()